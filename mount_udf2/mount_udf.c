@@ -88,11 +88,12 @@ main(int argc, char **argv)
 	struct udf_session_info usi;
 	struct iovec *iov;
 	struct passwd *nobody;
-	long session_num;
+	long readahead, session_num;
 	gid_t anon_gid, override_gid;
 	int iovlen, ch, mntflags, opts, sessioninfo;
 	uid_t anon_uid, override_uid;
 	mode_t mode, dirmode;
+	uint32_t readahead32;
 	char cs_local[ICONV_CSNMAXLEN];
 	char *dev, *dir, *endp, mntpath[MAXPATHLEN];
 	uint8_t use_nobody_gid, use_nobody_uid;
@@ -100,6 +101,7 @@ main(int argc, char **argv)
 	uint8_t use_mode, use_dirmode;
 
 	cs_local[0] = '\0';
+	readahead = -1;
 	session_num = 0;
 	sessioninfo = 0;
 	use_nobody_uid = use_nobody_gid = 1;
@@ -109,7 +111,7 @@ main(int argc, char **argv)
 	iovlen = 0;
 	mntflags = opts = 0;
 
-	while ((ch = getopt(argc, argv, "C:G:g:M:m:o:ps:U:u:")) != -1)
+	while ((ch = getopt(argc, argv, "C:G:g:M:m:o:pr:s:U:u:")) != -1)
 		switch (ch) {
 		case 'C':
 			set_charset(cs_local, optarg);
@@ -144,6 +146,14 @@ main(int argc, char **argv)
 		case 'p':
 			sessioninfo = 1;	
 			break;
+		case 'r':
+			readahead = strtol(optarg, &endp, 10);
+			if (optarg == endp || *endp != '\0' || readahead < 0 ||
+			    readahead > UINT32_MAX / 1024)
+				errx(EX_USAGE, "invalid number in option r: %s", 
+				    optarg);
+			readahead *= 1024;
+			break;
 		case 's':
 			session_num = strtol(optarg, &endp, 10);
 			if (optarg == endp || *endp != '\0')
@@ -227,6 +237,11 @@ main(int argc, char **argv)
 		build_iovec(&iov, &iovlen, "mode", &mode, sizeof(mode_t));
 	if (use_dirmode)
 		build_iovec(&iov, &iovlen, "dirmode", &dirmode, sizeof(mode_t));
+	if (readahead >= 0) {
+		readahead32 = readahead;
+		build_iovec(&iov, &iovlen, "readahead", &readahead32,
+		    sizeof(uint32_t));
+	}
 
 	build_iovec(&iov, &iovlen, "first_trackblank", 
 	    &usi.session_first_track_blank, sizeof(uint8_t));
@@ -382,7 +397,8 @@ usage(void)
 {
 
 	(void)fprintf(stderr, "usage: mount_udf [-v] [-C charset] [-G gid] "
-	    "[-o options] [-s session] [-U uid] special node\n");
+	    "[-o options] [-r readahead] [-s session] [-U uid] "
+	    "special node\n");
 	(void)fprintf(stderr, "usage: mount_udf [-p] [-s session] special\n");
 	exit(EX_USAGE);
 }
@@ -37,8 +37,9 @@
 #define UDF_REGID_NAME			99
 
 /* Configuration values */
-#define UDF_VAT_ALLOC_LIMIT	104857600		/* picked at random */
 #define UDF_VAT_CHUNKSIZE	(64*1024)		/* picked */
+#define UDF_VAT_PAGE_ENTRIES	(UDF_VAT_CHUNKSIZE / 4)
+#define UDF_VAT_UNMAPPED	0xffffffff
 #define UDF_SYMLINKBUFLEN	(64*1024)		/* picked */
 
 #define UDF_DISC_SLACK		(128)			/* picked, at least 64 kb or 128 */
@@ -47,7 +48,6 @@
 #define UDF_ANCHORS		4	/* 256, 512, N-256, N */
 #define UDF_PARTITIONS		4	/* overkill */
 #define UDF_PMAPS		5	/* overkill */
-#define UDF_MAX_ALLOC_EXTENTS	50	/* overkill */
 
 /* constants */
 #define UDF_MAX_NAMELEN		255	/* as per SPEC */
@@ -84,6 +84,36 @@ MALLOC_DECLARE(M_UDFTEMP);
 
 struct udf_node;
 
+/*
+ * Decoded allocation descriptor. A node's extent map is an array of these
+ * sorted on file offset, built once when the node is loaded.
+ */
+struct udf_extent {
+	uint64_t		 foffset;		/* file offset	     */
+	uint32_t		 len;			/* length in bytes   */
+	uint32_t		 flags;			/* UDF_EXT_* flags   */
+	uint32_t		 lb_num;		/* start in vpart    */
+	uint16_t		 vpart;			/* virtual partition */
+};
+
+/* host-endian sparing table entry, kept sorted on `org' */
+struct udf_sparing_ent {
+	uint32_t		 org;
+	uint32_t		 map;
+};
+
+/* identifies an unchanged volume, see udf_restore_snapshot() */
+struct udf_volkey {
+	char			 volset_id[128];
+	char			 logvol_id[128];
+	struct timestamp	 lvid_time;
+	uint64_t		 next_unique_id;
+	uint32_t		 session_start;
+	uint32_t		 last_written;
+	struct anchor_vdp	 anchor;		/* as read           */
+	struct desc_tag		 lvid_tag;		/* CRC of the LVID   */
+};
+
 struct udf_lvintq {
 	uint32_t		start;
 	uint32_t		end;
@@ -96,12 +126,16 @@ struct udf_mount {
 	struct vnode		*devvp;	
 	struct g_consumer	*geomcp;
 	uint32_t		 sector_size;
+	uint32_t		 bsize;			/* vnode block size  */
 	uint64_t		 flags;
 	uid_t			 anon_uid;
 	gid_t			 anon_gid;
 	void			*iconv_d2l;		/* disk to local */
+	uint32_t		*iconv_tbl;		/* see udf_iconv_table */
+	int			 iconv_ascii;		/* ASCII maps to itself */
 	mode_t			 mode;
 	mode_t			 dirmode;
+	uint32_t		 readahead;		/* max read-ahead    */
 
 	/* Used in mounting */
 	uint32_t		 first_trackblank;
@@ -109,6 +143,16 @@ struct udf_mount {
 	uint32_t		 session_end;
 	uint32_t		 session_last_written;
 
+	/* prefetched descriptor sequence, see udf_prefetch_dscrs() */
+	uint8_t			*dscr_win;
+	uint32_t		 dscr_win_start;	/* first sector      */
+	uint32_t		 dscr_win_len;		/* sectors in window */
+	uint32_t		 dscr_win_end;		/* end of extent     */
+	uint8_t			*dscr_alt;		/* fallback copy     */
+	uint32_t		 dscr_alt_start;
+	uint32_t		 dscr_alt_len;
+	uint32_t		 dscr_alt_end;
+
 	/* format descriptors */
 	struct anchor_vdp	*anchors[UDF_ANCHORS];	/* anchors to VDS    */
 	struct pri_vol_desc	*primary_vol;		/* identification    */
@@ -120,6 +164,9 @@ struct udf_mount {
 	/* logvol_info is derived; points *into* other structures */
 	struct udf_logvol_info	*logvol_info;		/* integrity descr.  */
 
+	/* volume as read from disc, before the VDS tables are applied */
+	struct udf_volkey	 volkey;
+
 	/* fileset and root directories */
 	struct fileset_desc	*fileset_desc;		/* normally one      */
 
@@ -131,16 +178,22 @@ struct udf_mount {
 	uint32_t		 first_possible_vat_location;
 	uint32_t		 last_possible_vat_location;
 	uint32_t		 vat_entries;
-	uint32_t		 vat_offset;		/* offset in table   */
-	uint32_t		 vat_table_alloc_len;
-	uint8_t			*vat_table;
+	uint32_t		 vat_offset;		/* offset in file    */
+	uint32_t		 vat_npages;
+	uint32_t		**vat_pages;		/* NULL: unmapped    */
+	struct udf_node		*vat_node;		/* set if on demand  */
+	struct udf_vat_demand	*vat_demand;		/* its bookkeeping   */
+	long			 vat_memused;
 
 	/* sparable */
 	uint32_t		 sparable_packet_size;
 	struct udf_sparing_table *sparing_table;
+	struct udf_sparing_ent	*sparing_map;		/* sorted on org     */
+	uint32_t		 sparing_map_len;
 
 	/* meta */
 	struct udf_node 	*metadata_node;		/* system node       */
+	struct udf_node		*metadata_mirror_node;	/* its mirror        */
 };
 
 /*
@@ -158,13 +211,38 @@ struct udf_node {
 	/* one of `fe' or `efe' can be set, not both (UDF file entry dscr.)  */
 	struct file_entry	*fe;
 	struct extfile_entry	*efe;
-	struct alloc_ext_entry	*ext[UDF_MAX_ALLOC_EXTENTS];
-	int			 num_extensions;
+
+	/* allocation descriptors of fe/efe and extents, redirects removed */
+	struct long_ad		*adslots;
+	int			 num_adslots;
+
+	/* extent map, sorted on file offset; read-only once loaded */
+	struct udf_extent	*extents;
+	int			 num_extents;
+
+	/* name index of large directories, built on first lookup */
+	struct udf_dirhash	*dirhash;
+	int			 dirhash_failed;
+
+	/* sequential read detection, see udf_read_seqcount() */
+	off_t			 ra_nextoff;		/* expected offset   */
+	uint32_t		 ra_window;		/* read-ahead bytes  */
 
 	/* location found, recording location & hints */
 	struct long_ad		 loc;			/* FID/hash loc.     */
 };
 
+/* iterator over the FIDs of a directory, see udf_dirstream_next() */
+struct udf_dirstream {
+	struct vnode		*vp;
+	uint64_t		 file_size;
+	uint64_t		 offset;		/* next FID */
+	uint8_t			*buf;			/* chunk of the stream */
+	uint64_t		 buf_off;		/* offset of buf[0] */
+	uint32_t		 buf_len;
+	uint32_t		 buf_size;
+};
+
 struct udf_fid {
 	u_short		len;		/* length of data in bytes */
 	u_short		padding;		/* force longword alignment */
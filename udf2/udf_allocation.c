@@ -86,17 +86,40 @@ udf_calc_freespace(struct udf_mount *ump, uint64_t *sizeblks,
 		*freeblks = 0;
 }
 
+/* binary search the sorted sparing map for a remapped packet */
+static struct udf_sparing_ent *
+udf_find_sparing_ent(struct udf_mount *ump, uint32_t packet)
+{
+	struct udf_sparing_ent *ent;
+	uint32_t lo, hi, mid;
+
+	lo = 0;
+	hi = ump->sparing_map_len;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		ent = &ump->sparing_map[mid];
+		if (ent->org == packet)
+			return (ent);
+		if (ent->org < packet)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return (NULL);
+}
+
 int
 udf_translate_vtop(struct udf_mount *ump, struct long_ad *icb_loc,
 		   uint32_t *lb_numres, uint32_t *extres)
 {
 	struct part_desc *pdesc;
-	struct spare_map_entry *sme;
-	struct long_ad s_icb_loc;
-	uint64_t end_foffset, foffset;
-	int eof, error, flags, part, rel, slot;
-	uint32_t lb_num, lb_packet, lb_rel, lb_size, len;
-	uint32_t ext_offset, udf_rw32_lbmap;
+	struct udf_sparing_ent *sme;
+	struct udf_extent *ext;
+	uint64_t foffset;
+	int error, part;
+	uint32_t lb_num, lb_packet, lb_rel, lb_size;
+	uint32_t ext_offset, *vat_page;
 	uint16_t vpart;
 
 	KASSERT(ump && icb_loc && lb_numres,("ump && icb_loc && lb_numres"));
@@ -130,13 +153,21 @@ translate_again:
 		if (lb_num >= ump->vat_entries)		/* XXX > or >= ? */
 			return (EINVAL);
 
-		/* lookup in virtual allocation table file */
-		error = udf_vat_read(ump, (uint8_t *)&udf_rw32_lbmap, 4, 
-		    ump->vat_offset + lb_num * 4);
-		if (error != 0)
-			return (error);
-
-		lb_num = le32toh(udf_rw32_lbmap);
+		/* lookup in the host-endian copy of the VAT */
+		if (ump->vat_node != NULL) {
+			/* read in on demand */
+			error = udf_lookup_vat(ump, lb_num, &lb_num);
+			if (error != 0)
+				return (error);
+		} else {
+			vat_page =
+			    ump->vat_pages[lb_num / UDF_VAT_PAGE_ENTRIES];
+			if (vat_page == NULL)
+				return (EINVAL);
+			lb_num = vat_page[lb_num % UDF_VAT_PAGE_ENTRIES];
+		}
+		if (lb_num == UDF_VAT_UNMAPPED)
+			return (EINVAL);
 
 		/* transform into its disc logical block */
 		if (lb_num > le32toh(pdesc->part_len))
@@ -151,14 +182,12 @@ translate_again:
 		lb_packet = lb_num / ump->sparable_packet_size;
 		lb_rel = lb_num % ump->sparable_packet_size;
 
-		for (rel = 0; rel < le16toh(ump->sparing_table->rt_l); rel++) {
-			sme = &ump->sparing_table->entries[rel];
-			if (lb_packet == le32toh(sme->org)) {
-				/* NOTE maps to absolute disc logical block! */
-				*lb_numres = le32toh(sme->map) + lb_rel;
-				*extres = ump->sparable_packet_size - lb_rel;
-				return (0);
-			}
+		sme = udf_find_sparing_ent(ump, lb_packet);
+		if (sme != NULL) {
+			/* NOTE maps to absolute disc logical block! */
+			*lb_numres = sme->map + lb_rel;
+			*extres = ump->sparable_packet_size - lb_rel;
+			return (0);
 		}
 
 		/* transform into its disc logical block */
@@ -172,49 +201,26 @@ translate_again:
 	case UDF_VTOP_TYPE_META:
 		/* we have to look into the file's allocation descriptors */
 
-		/* use metadatafile allocation mutex */
+		/*
+		 * The extent maps of the metadata nodes are built when they
+		 * are loaded and never change, so no node lock is needed.
+		 * Fall back on the mirror when the main file doesn't map it.
+		 */
 		lb_size = le32toh(ump->logical_vol->lb_size);
-
-		UDF_LOCK_NODE(ump->metadata_node, 0);
-
-		/* get first overlapping extent */
-		foffset = 0;
-		slot = 0;
-		for (;;) {
-			udf_get_adslot(ump->metadata_node, slot, &s_icb_loc,
-			    &eof);
-			if (eof) {
-				UDF_UNLOCK_NODE(ump->metadata_node, 0);
-				return (EINVAL);
-			}
-			len = le32toh(s_icb_loc.len);
-			flags = UDF_EXT_FLAGS(len);
-			len = UDF_EXT_LEN(len);
-
-			if (flags == UDF_EXT_REDIRECT) {
-				slot++;
-				continue;
-			}
-
-			end_foffset = foffset + len;
-
-			if (end_foffset > lb_num * lb_size)
-				break;	/* found */
-			foffset = end_foffset;
-			slot++;
-		}
-		/* found overlapping slot */
-		ext_offset = lb_num * lb_size - foffset;
+		foffset = (uint64_t)lb_num * lb_size;
+
+		ext = udf_find_extent(ump->metadata_node, foffset);
+		if ((ext == NULL || ext->flags != UDF_EXT_ALLOCATED) &&
+		    ump->metadata_mirror_node != NULL)
+			ext = udf_find_extent(ump->metadata_mirror_node,
+			    foffset);
+		if (ext == NULL || ext->flags != UDF_EXT_ALLOCATED)
+			return (EINVAL);
 
 		/* process extent offset */
-		lb_num = le32toh(s_icb_loc.loc.lb_num);
-		vpart = le16toh(s_icb_loc.loc.part_num);
-		lb_num  += (ext_offset + lb_size -1) / lb_size;
-		ext_offset = 0;
-
-		UDF_UNLOCK_NODE(ump->metadata_node, 0);
-		if (flags != UDF_EXT_ALLOCATED)
-			return (EINVAL);
+		ext_offset = foffset - ext->foffset;
+		vpart = ext->vpart;
+		lb_num = ext->lb_num + (ext_offset + lb_size - 1) / lb_size;
 
 		/*
 		 * vpart and lb_num are updated, translate again since we
@@ -229,6 +235,96 @@ translate_again:
 	return (EINVAL);
 }
 
+/*
+ * Decode the allocation descriptors of a node into its extent map. The map
+ * is built once when the node is loaded so that translating a file block
+ * doesn't have to walk all allocation descriptors from slot 0 again.
+ */
+int
+udf_build_extent_map(struct udf_node *udf_node)
+{
+	struct udf_extent *ext;
+	struct long_ad s_ad;
+	uint64_t foffset;
+	int eof, num_extents, slot;
+	uint32_t flags, len;
+
+	/* count the extents that actually map something */
+	num_extents = 0;
+	for (slot = 0; ; slot++) {
+		udf_get_adslot(udf_node, slot, &s_ad, &eof);
+		if (eof)
+			break;
+		len = le32toh(s_ad.len);
+		if (UDF_EXT_FLAGS(len) == UDF_EXT_REDIRECT)
+			continue;
+		if (UDF_EXT_LEN(len) == 0)
+			continue;
+		num_extents++;
+	}
+
+	udf_node->extents = NULL;
+	udf_node->num_extents = 0;
+	if (num_extents == 0)
+		return (0);
+
+	udf_node->extents = malloc(num_extents * sizeof(struct udf_extent),
+	    M_UDFTEMP, M_WAITOK);
+
+	/* and record them in file order */
+	ext = udf_node->extents;
+	foffset = 0;
+	for (slot = 0; ; slot++) {
+		udf_get_adslot(udf_node, slot, &s_ad, &eof);
+		if (eof)
+			break;
+		len = le32toh(s_ad.len);
+		flags = UDF_EXT_FLAGS(len);
+		len = UDF_EXT_LEN(len);
+		if (flags == UDF_EXT_REDIRECT)
+			continue;
+		if (len == 0)
+			continue;
+
+		ext->foffset = foffset;
+		ext->len = len;
+		ext->flags = flags;
+		ext->lb_num = le32toh(s_ad.loc.lb_num);
+		ext->vpart = le16toh(s_ad.loc.part_num);
+		ext++;
+
+		foffset += len;
+	}
+	udf_node->num_extents = num_extents;
+
+	return (0);
+}
+
+/*
+ * Binary search the extent map for the extent holding file offset foffset.
+ */
+struct udf_extent *
+udf_find_extent(struct udf_node *udf_node, uint64_t foffset)
+{
+	struct udf_extent *ext;
+	int hi, lo, mid;
+
+	lo = 0;
+	hi = udf_node->num_extents;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		ext = &udf_node->extents[mid];
+		if (foffset < ext->foffset)
+			hi = mid;
+		else if (foffset >= ext->foffset + ext->len)
+			lo = mid + 1;
+		else
+			return (ext);
+	}
+
+	return (NULL);
+}
+
 /* 
  * This is a simplified version of the udf_translate_file_extent function. 
  */
@@ -237,11 +333,11 @@ udf_bmap_translate(struct udf_node *udf_node, uint32_t block,
 		   int *exttype, uint64_t *lsector, uint32_t *maxblks)
 {
 	struct udf_mount *ump;
+	struct udf_extent *ext;
 	struct icb_tag *icbtag;
-	struct long_ad s_ad, t_ad;
-	uint64_t foffset, new_foffset;
-	int addr_type, eof, error, flags, icbflags, slot;
-	uint32_t ext_offset, ext_remain, lb_num, lb_size, len, transsec32;
+	struct long_ad t_ad;
+	int addr_type, error, icbflags;
+	uint32_t ext_offset, ext_remain, lb_num, lb_size, maxrun, transsec32;
 	uint32_t translen;
 	uint16_t vpart_num;
 
@@ -273,46 +369,26 @@ udf_bmap_translate(struct udf_node *udf_node, uint32_t block,
 		return (0);
 	}
 
-	/* find first overlapping extent */
-	foffset = 0;
-	slot = 0;
-	for (;;) {
-		udf_get_adslot(udf_node, slot, &s_ad, &eof);
-		if (eof) {
-			UDF_UNLOCK_NODE(udf_node, 0);
-			return (EINVAL);
-		}
-		len = le32toh(s_ad.len);
-		flags = UDF_EXT_FLAGS(len);
-		len = UDF_EXT_LEN(len);
-
-		if (flags == UDF_EXT_REDIRECT) {
-			slot++;
-			continue;
-		}
-
-		new_foffset = foffset + len;
-
-		if (new_foffset > block * lb_size)
-			break;	/* found */
-		foffset = new_foffset;
-		slot++;
+	/* find the overlapping extent */
+	ext = udf_find_extent(udf_node, (uint64_t)block * lb_size);
+	if (ext == NULL) {
+		UDF_UNLOCK_NODE(udf_node, 0);
+		return (EINVAL);
 	}
-	/* found overlapping slot */
 
-	lb_num = le32toh(s_ad.loc.lb_num);
-	vpart_num = le16toh(s_ad.loc.part_num);
+	lb_num = ext->lb_num;
+	vpart_num = ext->vpart;
 	
-	ext_offset = block * lb_size - foffset;
+	ext_offset = (uint64_t)block * lb_size - ext->foffset;
 	lb_num += (ext_offset + lb_size - 1) / lb_size;
-	ext_remain = (len - ext_offset + lb_size - 1) / lb_size;
+	ext_remain = (ext->len - ext_offset + lb_size - 1) / lb_size;
 
 	/*
 	 * note that the while(){} is nessisary for the extent that
 	 * the udf_translate_vtop() returns doens't have to span the
 	 * whole extent.
 	 */
-	switch (flags) {
+	switch (ext->flags) {
 	case UDF_EXT_FREE:
 	case UDF_EXT_ALLOCATED_BUT_NOT_USED:
 		*exttype = UDF_TRAN_ZERO;
@@ -329,6 +405,23 @@ udf_bmap_translate(struct udf_node *udf_node, uint32_t block,
 		}
 		*lsector = transsec32;
 		*maxblks = MIN(ext_remain, translen);
+
+		/*
+		 * A virtual partition maps one block at a time; merge the
+		 * blocks that were written out back to back into one run, up
+		 * to the largest I/O, so the callers can cluster their reads.
+		 */
+		maxrun = MIN(ext_remain,
+		    MAX(1, ump->vfs_mountp->mnt_iosize_max / lb_size));
+		while (*maxblks < maxrun) {
+			t_ad.loc.lb_num = htole32(lb_num + *maxblks);
+			if (udf_translate_vtop(ump, &t_ad, &transsec32,
+			    &translen) != 0)
+				break;
+			if (transsec32 != *lsector + *maxblks)
+				break;
+			*maxblks = MIN(ext_remain, *maxblks + translen);
+		}
 		break;
 	default:
 		UDF_UNLOCK_NODE(udf_node, 0);
@@ -340,104 +433,182 @@ udf_bmap_translate(struct udf_node *udf_node, uint32_t block,
 	return (0);
 }
 
-void
-udf_get_adslot(struct udf_node *udf_node, int slot, struct long_ad *icb,
-	int *eof) {
-	struct file_entry *fe;
-	struct extfile_entry *efe;
+/*
+ * Normalise all allocation descriptors of a node into one packed long_ad
+ * array. Both the descriptors recorded in the (e)fe and the ones in its chain
+ * of allocation extent descriptors are converted, and the redirects linking
+ * the chain are dropped, so a slot can be fetched by simple indexing.
+ */
+int
+udf_read_adslots(struct udf_node *udf_node)
+{
+	union dscrptr *dscr;
+	struct udf_mount *ump;
 	struct alloc_ext_entry *ext;
 	struct icb_tag *icbtag;
 	struct short_ad *short_ad;
-	struct long_ad *long_ad, l_icb;
-	int addr_type, adlen, extnr, icbflags;
-	uint32_t dscr_size, flags, lb_size, l_ad, l_ea, offset;
+	struct long_ad *adslots, l_icb, redirect;
+	uint64_t inf_len;
+	int addr_type, adlen, error, icbflags, max_adslots, num_adslots;
+	int redirected, size;
+	uint32_t dscr_size, dummy, l_ad, l_ea, lb_size, max_slots, offset;
+	uint32_t num_exts, sector;
 	uint8_t *data_pos;
 
-	/* determine what descriptor we are in */
-	lb_size = le32toh(udf_node->ump->logical_vol->lb_size);
-
-	fe = udf_node->fe;
-	efe = udf_node->efe;
-	if (fe != NULL) {
-		icbtag = &fe->icbtag;
-		dscr_size = sizeof(struct file_entry) -1;
-		l_ea = le32toh(fe->l_ea);
-		l_ad = le32toh(fe->l_ad);
-		data_pos = (uint8_t *)fe + dscr_size + l_ea;
+	ump = udf_node->ump;
+	lb_size = le32toh(ump->logical_vol->lb_size);
+
+	udf_node->adslots = NULL;
+	udf_node->num_adslots = 0;
+
+	if (udf_node->fe != NULL) {
+		icbtag = &udf_node->fe->icbtag;
+		inf_len = le64toh(udf_node->fe->inf_len);
+		l_ea = le32toh(udf_node->fe->l_ea);
+		l_ad = le32toh(udf_node->fe->l_ad);
+		data_pos = udf_node->fe->data + l_ea;
 	} else {
-		icbtag = &efe->icbtag;
-		dscr_size = sizeof(struct extfile_entry) -1;
-		l_ea = le32toh(efe->l_ea);
-		l_ad = le32toh(efe->l_ad);
-		data_pos = (uint8_t *)efe + dscr_size + l_ea;
+		icbtag = &udf_node->efe->icbtag;
+		inf_len = le64toh(udf_node->efe->inf_len);
+		l_ea = le32toh(udf_node->efe->l_ea);
+		l_ad = le32toh(udf_node->efe->l_ad);
+		data_pos = udf_node->efe->data + l_ea;
 	}
 
 	icbflags = le16toh(icbtag->flags);
 	addr_type = icbflags & UDF_ICB_TAG_FLAGS_ALLOC_MASK;
 
-	/* just in case we're called on an intern, its EOF */
-	if (addr_type == UDF_ICB_INTERN_ALLOC) {
-		memset(icb, 0, sizeof(struct long_ad));
-		*eof = 1;
-		return;
-	}
+	/* an intern allocated node has no allocation descriptors */
+	if (addr_type == UDF_ICB_INTERN_ALLOC)
+		return (0);
 
-	adlen = 0;
 	if (addr_type == UDF_ICB_SHORT_ALLOC)
 		adlen = sizeof(struct short_ad);
 	else if (addr_type == UDF_ICB_LONG_ALLOC)
 		adlen = sizeof(struct long_ad);
+	else
+		return (EINVAL);
 
-	/* if offset too big, we go to the allocation extensions */
-	offset = slot * adlen;
-	extnr = -1;
-	while (offset >= l_ad) {
-		/* check if our last entry is a redirect */
-		if (addr_type == UDF_ICB_SHORT_ALLOC) {
-			short_ad = (struct short_ad *)(data_pos + l_ad-adlen);
-			l_icb.len = short_ad->len;
-			l_icb.loc.part_num = udf_node->loc.loc.part_num;
-			l_icb.loc.lb_num = short_ad->lb_num;
-		} else {
-			KASSERT(addr_type == UDF_ICB_LONG_ALLOC,
-			    ("addr_type == UDF_ICB_LONG_ALLOC"));
-			long_ad = (struct long_ad *)(data_pos + l_ad-adlen);
-			l_icb = *long_ad;
+	/*
+	 * Sanity limit for corrupt or looping extension chains; a file can't
+	 * sensibly be described by more extents than it has blocks, allow
+	 * some slack for preallocated extents past its end.  The same bound
+	 * applies to the number of extension blocks followed, since a chain
+	 * of redirects only would add no slots at all.
+	 */
+	max_slots = (inf_len + lb_size - 1) / lb_size + 128;
+
+	adslots = NULL;
+	max_adslots = num_adslots = 0;
+	num_exts = 0;
+	ext = NULL;
+	error = 0;
+	for (;;) {
+		redirected = 0;
+		for (offset = 0; offset + adlen <= l_ad; offset += adlen) {
+			if (addr_type == UDF_ICB_SHORT_ALLOC) {
+				short_ad = (struct short_ad *)(data_pos + offset);
+				memset(&l_icb, 0, sizeof(struct long_ad));
+				l_icb.len = short_ad->len;
+				l_icb.loc.part_num = udf_node->loc.loc.part_num;
+				l_icb.loc.lb_num = short_ad->lb_num;
+			} else {
+				l_icb = *(struct long_ad *)(data_pos + offset);
+			}
+
+			/* a zero length extent terminates the sequence */
+			if (UDF_EXT_LEN(le32toh(l_icb.len)) == 0)
+				break;
+
+			if (UDF_EXT_FLAGS(le32toh(l_icb.len)) ==
+			    UDF_EXT_REDIRECT) {
+				redirect = l_icb;
+				redirected = 1;
+				break;
+			}
+
+			if (num_adslots >= max_slots) {
+				error = EINVAL;
+				break;
+			}
+			if (num_adslots == max_adslots) {
+				max_adslots = max_adslots ? max_adslots * 2 : 16;
+				size = max_adslots * sizeof(struct long_ad);
+				adslots = realloc(adslots, size, M_UDFTEMP,
+				    M_WAITOK);
+			}
+			adslots[num_adslots++] = l_icb;
+		}
+
+		/* the allocation extent has been fully decoded */
+		if (ext != NULL) {
+			free(ext, M_UDFTEMP);
+			ext = NULL;
+		}
+
+		if (error != 0 || redirected == 0)
+			break;
+
+		if (++num_exts > max_slots) {
+			error = EINVAL;
+			break;
 		}
-		flags = UDF_EXT_FLAGS(le32toh(l_icb.len));
-		if (flags != UDF_EXT_REDIRECT) {
-			l_ad = 0;	/* force EOF */
+
+		/* length can only be *one* lb : UDF 2.50/2.3.7.1 */
+		if (UDF_EXT_LEN(le32toh(redirect.len)) != lb_size) {
+			error = EINVAL;
 			break;
 		}
 
-		/* advance to next extent */
-		extnr++;
-		if (extnr >= udf_node->num_extensions) {
-			l_ad = 0;	/* force EOF */
+		/* load in allocation extent */
+		error = udf_translate_vtop(ump, &redirect, &sector, &dummy);
+		if (error == 0)
+			error = udf_read_phys_dscr(ump, sector, M_UDFTEMP,
+			    &dscr);
+		if (error == 0 && dscr == NULL)
+			error = ENOENT;
+		if (error != 0)
+			break;
+
+		if (le16toh(dscr->tag.id) != TAGID_ALLOCEXTENT) {
+			free(dscr, M_UDFTEMP);
+			error = ENOENT;
 			break;
 		}
-		offset = offset - l_ad;
-		ext = udf_node->ext[extnr];
+
+		ext = &dscr->aee;
 		dscr_size = sizeof(struct alloc_ext_entry) - 1;
 		l_ad = le32toh(ext->l_ad);
-		data_pos = (uint8_t *)ext + dscr_size;
+		if (l_ad > lb_size - dscr_size)
+			l_ad = lb_size - dscr_size;
+		data_pos = ext->data;
 	}
 
-	/* XXX l_ad == 0 should be enough to check */
-	*eof = (offset >= l_ad) || (l_ad == 0);
+	if (error != 0) {
+		if (adslots != NULL)
+			free(adslots, M_UDFTEMP);
+		return (error);
+	}
+
+	udf_node->adslots = adslots;
+	udf_node->num_adslots = num_adslots;
+
+	return (0);
+}
+
+/*
+ * Fetch allocation descriptor `slot'; redirects are already resolved by
+ * udf_read_adslots().
+ */
+void
+udf_get_adslot(struct udf_node *udf_node, int slot, struct long_ad *icb,
+	int *eof) {
+
+	*eof = (slot < 0) || (slot >= udf_node->num_adslots);
 	if (*eof) {
 		memset(icb, 0, sizeof(struct long_ad));
 		return;
 	}
 
-	/* get the element */
-	if (addr_type == UDF_ICB_SHORT_ALLOC) {
-		short_ad = (struct short_ad *)(data_pos + offset);
-		icb->len = short_ad->len;
-		icb->loc.part_num = udf_node->loc.loc.part_num;
-		icb->loc.lb_num = short_ad->lb_num;
-	} else if (addr_type == UDF_ICB_LONG_ALLOC) {
-		long_ad = (struct long_ad *)(data_pos + offset);
-		*icb = *long_ad;
-	}
+	*icb = udf_node->adslots[slot];
 }
@@ -0,0 +1,327 @@
+/*-
+ * Copyright (c) 2026 The udf2 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * In-memory name index for large directories.  The volume is read-only, so
+ * an index built once stays valid until the directory vnode is reclaimed.
+ */
+
+#include <sys/param.h>
+#include <sys/cdefs.h>
+#include <sys/endian.h>
+#include <sys/systm.h>
+#include <sys/kernel.h>
+#include <sys/lock.h>
+#include <sys/mutex.h>
+#include <sys/malloc.h>
+#include <sys/fnv_hash.h>
+#include <sys/mount.h>
+#include <sys/vnode.h>
+#include <sys/sysctl.h>
+
+#include "ecma167-udf.h"
+#include "udf.h"
+#include "udf_subr.h"
+
+struct udf_dirhash_ent {
+	uint32_t	 hash;
+	uint32_t	 next;		/* next entry in bucket or UDF_DH_NIL */
+	uint32_t	 nameoff;	/* offset in name pool */
+	uint32_t	 namelen;
+	uint64_t	 diroff;	/* offset just past the FID */
+	ino_t		 id;
+};
+
+struct udf_dirhash {
+	uint32_t		*buckets;
+	uint32_t		 hashmask;
+	struct udf_dirhash_ent	*ents;
+	uint32_t		 nents;
+	char			*names;
+	uint32_t		 nameslen;
+	ino_t			 parent;
+	uint64_t		 parent_diroff;
+	size_t			 memused;
+};
+
+#define UDF_DH_NIL	0xffffffffU
+
+SYSCTL_DECL(_vfs_udf2);
+
+static int udf_dirhash_minsize = 16 * 1024;
+SYSCTL_INT(_vfs_udf2, OID_AUTO, dirhash_minsize, CTLFLAG_RW,
+    &udf_dirhash_minsize, 0, "minimum directory size to build an index for");
+
+static long udf_dirhash_maxmem = 2 * 1024 * 1024;
+SYSCTL_LONG(_vfs_udf2, OID_AUTO, dirhash_maxmem, CTLFLAG_RW,
+    &udf_dirhash_maxmem, 0, "maximum memory used by directory indexes");
+
+static long udf_dirhash_mem;
+SYSCTL_LONG(_vfs_udf2, OID_AUTO, dirhash_mem, CTLFLAG_RD,
+    &udf_dirhash_mem, 0, "memory used by directory indexes");
+
+static struct mtx udf_dirhash_mtx;
+MTX_SYSINIT(udf_dirhash, &udf_dirhash_mtx, "udf dirhash", MTX_DEF);
+
+static void
+udf_dirhash_destroy(struct udf_dirhash *dh)
+{
+
+	free(dh->buckets, M_UDFTEMP);
+	free(dh->ents, M_UDFTEMP);
+	free(dh->names, M_UDFTEMP);
+	free(dh, M_UDFTEMP);
+}
+
+/* account for an allocation; fails when the budget would be exceeded */
+static int
+udf_dirhash_charge(struct udf_dirhash *dh, size_t size)
+{
+	int error;
+
+	error = 0;
+	mtx_lock(&udf_dirhash_mtx);
+	if (udf_dirhash_mem + size > udf_dirhash_maxmem)
+		error = ENOSPC;
+	else
+		udf_dirhash_mem += size;
+	mtx_unlock(&udf_dirhash_mtx);
+
+	if (error == 0)
+		dh->memused += size;
+	return (error);
+}
+
+static void
+udf_dirhash_uncharge(struct udf_dirhash *dh)
+{
+
+	mtx_lock(&udf_dirhash_mtx);
+	udf_dirhash_mem -= dh->memused;
+	mtx_unlock(&udf_dirhash_mtx);
+	dh->memused = 0;
+}
+
+static int
+udf_dirhash_add(struct udf_dirhash *dh, uint32_t *maxents, uint32_t *maxnames,
+    const char *name, int namelen, ino_t id, uint64_t diroff)
+{
+	struct udf_dirhash_ent *ent;
+	uint32_t newmax;
+	int error;
+
+	if (dh->nents == *maxents) {
+		newmax = MAX(64, *maxents * 2);
+		error = udf_dirhash_charge(dh,
+		    (newmax - *maxents) * sizeof(struct udf_dirhash_ent));
+		if (error != 0)
+			return (error);
+		dh->ents = realloc(dh->ents,
+		    newmax * sizeof(struct udf_dirhash_ent), M_UDFTEMP,
+		    M_WAITOK);
+		*maxents = newmax;
+	}
+	while (dh->nameslen + namelen > *maxnames) {
+		newmax = MAX(1024, *maxnames * 2);
+		error = udf_dirhash_charge(dh, newmax - *maxnames);
+		if (error != 0)
+			return (error);
+		dh->names = realloc(dh->names, newmax, M_UDFTEMP, M_WAITOK);
+		*maxnames = newmax;
+	}
+
+	ent = &dh->ents[dh->nents++];
+	ent->hash = fnv_32_buf(name, namelen, FNV1_32_INIT);
+	ent->nameoff = dh->nameslen;
+	ent->namelen = namelen;
+	ent->diroff = diroff;
+	ent->id = id;
+	memcpy(dh->names + dh->nameslen, name, namelen);
+	dh->nameslen += namelen;
+
+	return (0);
+}
+
+/*
+ * Walk the whole directory once and record every visible name.  Returns
+ * non-zero when the directory could not be indexed within the budget.
+ */
+static int
+udf_dirhash_build(struct vnode *dvp, struct udf_dirhash **dhp)
+{
+	struct udf_node *dir_node = VTOI(dvp);
+	struct udf_mount *ump = dir_node->ump;
+	struct udf_dirhash *dh;
+	struct udf_dirstream ds;
+	struct fileid_desc *fid;
+	uint32_t maxents, maxnames, nbuckets, i;
+	ino_t id;
+	int error, unix_len;
+	uint8_t *fid_name;
+	char *unix_name;
+
+	dh = malloc(sizeof(struct udf_dirhash), M_UDFTEMP, M_WAITOK | M_ZERO);
+	unix_name = malloc(MAXNAMLEN, M_UDFTEMP, M_WAITOK);
+	maxents = maxnames = 0;
+
+	udf_dirstream_init(&ds, dvp, 0);
+	for (;;) {
+		error = udf_dirstream_next(&ds, &fid);
+		if (error != 0 || fid == NULL)
+			break;
+
+		if (fid->file_char & (UDF_FILE_CHAR_DEL | UDF_FILE_CHAR_VIS))
+			continue;
+
+		error = udf_get_node_id(fid->icb, &id);
+		if (error != 0)
+			break;
+
+		if (fid->file_char & UDF_FILE_CHAR_PAR) {
+			if (dh->parent == 0) {
+				dh->parent = id;
+				dh->parent_diroff = ds.offset;
+			}
+			continue;
+		}
+
+		fid_name = fid->data + le16toh(fid->l_iu);
+		udf_to_unix_name(ump, unix_name, MAXNAMLEN, fid_name,
+		    fid->l_fi);
+		unix_len = strlen(unix_name);
+
+		error = udf_dirhash_add(dh, &maxents, &maxnames, unix_name,
+		    unix_len, id, ds.offset);
+		if (error != 0)
+			break;
+	}
+	udf_dirstream_done(&ds);
+	free(unix_name, M_UDFTEMP);
+
+	if (error == 0) {
+		nbuckets = 16;
+		while (nbuckets < dh->nents)
+			nbuckets <<= 1;
+		error = udf_dirhash_charge(dh, nbuckets * sizeof(uint32_t));
+	}
+	if (error != 0) {
+		udf_dirhash_uncharge(dh);
+		udf_dirhash_destroy(dh);
+		return (error);
+	}
+
+	dh->hashmask = nbuckets - 1;
+	dh->buckets = malloc(nbuckets * sizeof(uint32_t), M_UDFTEMP, M_WAITOK);
+	memset(dh->buckets, 0xff, nbuckets * sizeof(uint32_t));
+
+	/* insert back to front so each chain is in directory order */
+	for (i = dh->nents; i > 0; i--) {
+		dh->ents[i - 1].next = dh->buckets[dh->ents[i - 1].hash &
+		    dh->hashmask];
+		dh->buckets[dh->ents[i - 1].hash & dh->hashmask] = i - 1;
+	}
+
+	*dhp = dh;
+	return (0);
+}
+
+/*
+ * Look up a name in the index of directory `dvp', building the index on
+ * first use.  Returns ENOENT when the name is not present and EOPNOTSUPP
+ * when the directory is not indexed and has to be scanned instead.
+ */
+int
+udf_dirhash_lookup(struct vnode *dvp, const char *name, int namelen,
+    int isdotdot, ino_t *id, uint64_t *diroff)
+{
+	struct udf_node *dir_node = VTOI(dvp);
+	struct udf_dirhash *dh, *newdh;
+	struct udf_dirhash_ent *ent;
+	uint64_t file_size;
+	uint32_t hash, i;
+
+	dh = dir_node->dirhash;
+	if (dh == NULL) {
+		if (dir_node->dirhash_failed)
+			return (EOPNOTSUPP);
+		if (dir_node->fe != NULL)
+			file_size = le64toh(dir_node->fe->inf_len);
+		else
+			file_size = le64toh(dir_node->efe->inf_len);
+		if (file_size < udf_dirhash_minsize)
+			return (EOPNOTSUPP);
+
+		if (udf_dirhash_build(dvp, &newdh) != 0) {
+			dir_node->dirhash_failed = 1;
+			return (EOPNOTSUPP);
+		}
+
+		/* lookups may run with the vnode shared locked */
+		mtx_lock(&udf_dirhash_mtx);
+		dh = dir_node->dirhash;
+		if (dh == NULL)
+			dir_node->dirhash = dh = newdh;
+		mtx_unlock(&udf_dirhash_mtx);
+		if (dh != newdh) {
+			udf_dirhash_uncharge(newdh);
+			udf_dirhash_destroy(newdh);
+		}
+	}
+
+	if (isdotdot) {
+		if (dh->parent == 0)
+			return (ENOENT);
+		*id = dh->parent;
+		*diroff = dh->parent_diroff;
+		return (0);
+	}
+
+	hash = fnv_32_buf(name, namelen, FNV1_32_INIT);
+	for (i = dh->buckets[hash & dh->hashmask]; i != UDF_DH_NIL;
+	    i = ent->next) {
+		ent = &dh->ents[i];
+		if (ent->hash == hash && ent->namelen == namelen &&
+		    memcmp(dh->names + ent->nameoff, name, namelen) == 0) {
+			*id = ent->id;
+			*diroff = ent->diroff;
+			return (0);
+		}
+	}
+
+	return (ENOENT);
+}
+
+void
+udf_dirhash_free(struct udf_node *udf_node)
+{
+
+	if (udf_node->dirhash == NULL)
+		return;
+
+	udf_dirhash_uncharge(udf_node->dirhash);
+	udf_dirhash_destroy(udf_node->dirhash);
+	udf_node->dirhash = NULL;
+}
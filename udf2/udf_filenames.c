@@ -81,16 +81,96 @@ udf_to_utf8(char **result, size_t *rrem, uint32_t ch)
 	return (n);
 }
 
+/*
+ * Translating through iconv one UTF-16 code unit at a time costs an
+ * indirect call per character, so the translation of every code unit is
+ * computed once at mount time.  An entry holds the length of the local
+ * sequence in its top byte and up to three bytes of it, first byte lowest;
+ * a length of zero means the character cannot be represented and
+ * UDF_XLAT_LONG that iconv has to be asked each time.
+ */
+#define	UDF_XLAT_ENTRIES	65536
+#define	UDF_XLAT_LONG		0xffU
+
+void
+udf_iconv_table(struct udf_mount *ump)
+{
+	size_t chrem, rrem;
+	uint32_t ent, uch;
+	int i, n;
+	char ch[2], out[8], *rp;
+	const char *chp;
+
+	ump->iconv_tbl = malloc(UDF_XLAT_ENTRIES * sizeof(uint32_t),
+	    M_UDFTEMP, M_WAITOK);
+	ump->iconv_ascii = 1;
+
+	for (uch = 0; uch < UDF_XLAT_ENTRIES; uch++) {
+		chrem = 2;
+		chp = ch;
+		ch[0] = uch >> 8;
+		ch[1] = uch & 0x00FF;
+		rp = out;
+		rrem = sizeof(out);
+		udf2_iconv->convchr(ump->iconv_d2l, &chp, &chrem, &rp, &rrem);
+
+		n = sizeof(out) - rrem;
+		if (chrem > 0)
+			ent = 0;
+		else if (n == 0 || n > 3)
+			ent = UDF_XLAT_LONG << 24;
+		else {
+			ent = n << 24;
+			for (i = 0; i < n; i++)
+				ent |= (uint8_t)out[i] << (8 * i);
+		}
+		ump->iconv_tbl[uch] = ent;
+
+		if (uch > 0 && uch < 0x80 && ent != ((1 << 24) | uch))
+			ump->iconv_ascii = 0;
+	}
+}
+
+/* append the local representation of uch; returns 0 if it doesn't fit */
+static int
+udf_to_local(struct udf_mount *ump, char **result, size_t *rrem, uint32_t uch)
+{
+	size_t chrem;
+	uint32_t ent;
+	int i, n;
+	char ch[2];
+	const char *chp;
+
+	ent = ump->iconv_tbl[uch];
+	n = ent >> 24;
+	if (n == UDF_XLAT_LONG) {
+		chrem = 2;
+		chp = ch;
+		ch[0] = uch >> 8;
+		ch[1] = uch & 0x00FF;
+		udf2_iconv->convchr(ump->iconv_d2l, &chp, &chrem, result,
+		    rrem);
+		return (chrem == 0);
+	}
+	if (n == 0 || n > *rrem)
+		return (0);
+
+	for (i = 0; i < n; i++)
+		(*result)[i] = ent >> (8 * i);
+	*result += n;
+	*rrem -= n;
+	return (1);
+}
+
 static void 
 udf_convert_str(struct udf_mount *ump, char *result, int *result_len,
     uint8_t *id, int id_len, uint16_t *index, int *needsCRC, int *extloc, 
     int eightbit) 
 {
-	size_t chrem, rrem;
+	size_t rrem;
 	int endi, i, invalid;
 	uint32_t uch;
-	char ch[2], *rp;
-	const char *chp;
+	char *rp;
 
 	if (eightbit)
 		endi = id_len;
@@ -121,15 +201,9 @@ udf_convert_str(struct udf_mount *ump, char *result, int *result_len,
 		} else if (uch == 0 || uch == 0x2F) {
 			/* do not allow nulls or slashes */
 			invalid++;
-		} else if (ump->flags & UDFMNT_KICONV && udf2_iconv) {
+		} else if (ump->iconv_tbl != NULL) {
 			/* it might be a valid character */
-			chrem = 2;
-			chp = ch;
-			ch[0] = uch >> 8;
-			ch[1] = uch & 0x00FF;
-			udf2_iconv->convchr(ump->iconv_d2l, &chp, &chrem, &rp,
-			    &rrem);
-			if (chrem > 0) {
+			if (udf_to_local(ump, &rp, &rrem, uch) == 0) {
 				/* not printable or doesn't fit */
 				invalid++;
 				*needsCRC = 1;
@@ -159,14 +233,9 @@ udf_convert_str(struct udf_mount *ump, char *result, int *result_len,
 			uch = 0x5F; // underscore
 
 			/* if the result doesn't have space this may not fit */
-			if (ump->flags & UDFMNT_KICONV && udf2_iconv) {
-				chrem = 2;
-				chp = ch;
-				ch[0] = uch >> 8;
-				ch[1] = uch & 0x00FF;
-				udf2_iconv->convchr(ump->iconv_d2l, &chp,
-				    &chrem, &rp, &rrem); 
-			} else
+			if (ump->iconv_tbl != NULL)
+				udf_to_local(ump, &rp, &rrem, uch);
+			else
 				udf_to_utf8(&rp, &rrem, uch);
 
 			invalid++;
@@ -190,9 +259,44 @@ udf_convert_str(struct udf_mount *ump, char *result, int *result_len,
 	*result_len -= rrem;
 }
 
+/*
+ * Check whether an 8 bit name consists only of ASCII characters that need
+ * no translation, i.e. no NULs, slashes or bytes above 0x7f.  The bulk is
+ * tested a word at a time using the usual "has zero byte" trick.
+ */
+#define	UDF_ONES	0x0101010101010101ULL
+#define	UDF_HIGHS	0x8080808080808080ULL
+#define	UDF_HASZERO(v)	(((v) - UDF_ONES) & ~(v) & UDF_HIGHS)
+
+static int
+udf_name_is_plain(const uint8_t *id, int id_len)
+{
+	uint64_t v;
+	int i;
+
+	for (i = 0; i + 8 <= id_len; i += 8) {
+		memcpy(&v, id + i, sizeof(v));
+		if ((v | UDF_HASZERO(v) | UDF_HASZERO(v ^ ('/' * UDF_ONES))) &
+		    UDF_HIGHS)
+			return (0);
+	}
+	for (; i < id_len; i++)
+		if (id[i] == 0 || id[i] == '/' || id[i] > 0x7f)
+			return (0);
+
+	return (1);
+}
+
+/*
+ * Space for the converted "#XXXX" CRC and extension of a truncated name;
+ * the extension is at most five characters.
+ */
+#define	UDF_NAME_SUFFIX_SIZE	32
+
 /*
  * The result_len is assumed to include the zero.
- * id_len - 1 is character, not \0.
+ * id_len - 1 is character, not \0.  id_len is at most UDF_MAX_NAMELEN, as
+ * it comes from an 8 bit length field, so all scratch space is on the stack.
  */
 void
 udf_to_unix_name(struct udf_mount *ump, char *result, int result_len, 
@@ -200,8 +304,8 @@ udf_to_unix_name(struct udf_mount *ump, char *result, int result_len,
 {
 	int crclen, eightbit, extlen, extloc, i, junkloc, mainlen, maxmainlen;
 	int maxnpart, needsCRC;
-	uint16_t crcsum, *index;
-	char *crc, crcbuf[6], *ext;
+	uint16_t crcsum, index[UDF_MAX_NAMELEN + 1];
+	char crc[UDF_NAME_SUFFIX_SIZE], crcbuf[6], ext[UDF_NAME_SUFFIX_SIZE];
 
 	if (id[0] != 8 && id[0] != 16) {
 		/* this is either invalid or an empty string */
@@ -218,7 +322,14 @@ udf_to_unix_name(struct udf_mount *ump, char *result, int result_len,
 	id++;
 	id_len--;
 
-	index = malloc((id_len + 1) * sizeof(uint16_t), M_UDFTEMP, M_WAITOK);
+	/* plain ASCII names that fit are copied as is */
+	if (eightbit && id_len < result_len &&
+	    (ump->iconv_tbl == NULL || ump->iconv_ascii) &&
+	    udf_name_is_plain(id, id_len)) {
+		memcpy(result, id, id_len);
+		result[id_len] = '\0';
+		return;
+	}
 
 	mainlen = result_len;
 	udf_convert_str(ump, result, &mainlen, id, id_len, index, &needsCRC,
@@ -227,15 +338,13 @@ udf_to_unix_name(struct udf_mount *ump, char *result, int result_len,
 	if (needsCRC) {
 		if (extloc) {
 			//build ext
-			ext = malloc(result_len, M_UDFTEMP, M_WAITOK | M_ZERO);
-			extlen = result_len;
+			memset(ext, 0, sizeof(ext));
+			extlen = MIN(result_len, sizeof(ext));
 			udf_convert_str(ump, ext, &extlen, id + extloc, 
 			    id_len - extloc, NULL, &needsCRC, &junkloc,
 			    eightbit);
-		} else {
-			ext = NULL;
+		} else
 			extlen = 1;
-		}
 		
 		crcsum = udf_cksum(id, id_len);
 		crcbuf[0] = '#';
@@ -245,8 +354,8 @@ udf_to_unix_name(struct udf_mount *ump, char *result, int result_len,
 		crcbuf[4] = "0123456789ABCDEF"[crcsum & 0x000F];
 		crcbuf[5] = '\0';
 
-		crc = malloc(result_len, M_UDFTEMP, M_WAITOK | M_ZERO);
-		crclen = result_len;
+		memset(crc, 0, sizeof(crc));
+		crclen = MIN(result_len, sizeof(crc));
 		udf_convert_str(ump, crc, &crclen, crcbuf, 5, NULL, &needsCRC,
 		    &junkloc, 1);
 
@@ -263,14 +372,8 @@ udf_to_unix_name(struct udf_mount *ump, char *result, int result_len,
 		i--;
 
 		memcpy(result + index[i + 1], crc, crclen - 1);
-		if (ext)
+		if (extloc)
 			memcpy(result + index[i + 1] + crclen - 1, ext, extlen);
 		result[index[i + 1] + crclen + extlen - 2] = '\0';
-
-		if (ext)
-			free(ext, M_UDFTEMP);
-		free(crc, M_UDFTEMP);
 	}
-
-	free(index, M_UDFTEMP);
 }
@@ -31,7 +31,11 @@
 #include <sys/systm.h>
 #include <sys/vnode.h>
 #include <sys/buf.h>
+#include <sys/bio.h>
 #include <sys/malloc.h>
+#include <sys/refcount.h>
+
+#include <geom/geom.h>
 
 #include "ecma167-udf.h"
 #include "udf.h"
@@ -40,6 +44,15 @@
 
 static int	udf_read_phys_sectors(struct udf_mount *ump, int what, 
 		    void *blob, uint32_t start, uint32_t sectors);
+static int	udf_read_phys_direct(struct udf_mount *ump, void *blob,
+		    uint64_t start, uint32_t sectors);
+static int	udf_read_phys_run(struct udf_mount *ump, uint8_t *blob,
+		    uint64_t lsect, uint32_t offset, uint32_t length);
+static struct bio *udf_start_phys_direct(struct udf_mount *ump, void *blob,
+		    uint64_t start, uint32_t sectors,
+		    void (*done)(struct bio *), void *caller1);
+static int	udf_wait_phys_direct(struct bio *bip);
+static int	udf_fill_dscr_window(struct udf_mount *ump, uint32_t start);
 
 /*
  * Set of generic descriptor readers and writers and their helper functions.
@@ -55,16 +68,13 @@ static int	udf_read_phys_sectors(struct udf_mount *ump, int what,
 int
 udf_read_node(struct udf_node *unode, uint8_t *blob, off_t start, int length)
 {
-	struct vnode *devvp = unode->ump->devvp;
-	struct buf *bp;
-	uint64_t file_size, lsect;
+	uint64_t file_size, lsect, runlen;
 	int addr_type, exttype, error, icbflags;
-	uint32_t blkinsect, fileblk, fileblkoff, numb, numlsect, sector_size;
+	uint32_t fileblk, fileblkoff, numb, numlsect, sector_size;
 	uint8_t  *pos;
 
 	error = 0;
 	sector_size = unode->ump->sector_size;
-	blkinsect = sector_size / DEV_BSIZE;
 
 	if (unode->fe != NULL) {
 		pos = &unode->fe->data[0] + le32toh(unode->fe->l_ea);
@@ -76,60 +86,487 @@ udf_read_node(struct udf_node *unode, uint8_t *blob, off_t start, int length)
 		file_size = le64toh(unode->efe->inf_len);
 	}
 
-	length = min(file_size - start, length);
+	if ((uint64_t)length > file_size - start)
+		length = file_size - start;
 	fileblk = start / sector_size;
 	fileblkoff = start % sector_size;
 
 	addr_type = icbflags & UDF_ICB_TAG_FLAGS_ALLOC_MASK;
 	if (addr_type == UDF_ICB_INTERN_ALLOC) {
-		numb = min(length, file_size - fileblkoff);
+		numb = MIN(length, file_size - fileblkoff);
 		memcpy(blob, pos + fileblkoff, numb);
 		return (error);
 	}
 
-	while (length) {
+	while (length > 0) {
 		error = udf_bmap_translate(unode, fileblk, &exttype, &lsect,
 		    &numlsect);
 		if (error != 0)
 			return (error);
 
-		if (exttype == UDF_TRAN_ZERO) {
-			numb = min(length, sector_size * numlsect - fileblkoff);
+		/* the part of this run we are interested in */
+		runlen = (uint64_t)numlsect * sector_size - fileblkoff;
+		numb = MIN(length, runlen);
+
+		if (exttype == UDF_TRAN_ZERO)
 			memset(blob, 0, numb);
-			length -= numb;
-			blob += numb;
-			fileblkoff = 0;
-		} else if (exttype == UDF_TRAN_INTERN)
+		else if (exttype == UDF_TRAN_INTERN)
 			return (EDOOFUS);
 		else {
-			while (numlsect > 0) {
-				error = bread(devvp, lsect * blkinsect,
-				    sector_size, NOCRED, &bp);
-				if (error != 0) {
-					if (buf != NULL)
-						brelse(bp);
-					return (error);
-				}
-		
-				numb = min(length, sector_size - fileblkoff);
-				bcopy(bp->b_data + fileblkoff, blob, numb);
-				brelse(bp);
-				bp = NULL;
-		
-				blob += numb;
-				length -= numb;
-				lsect++;
-				numlsect--;
-				fileblkoff = 0;
+			error = udf_read_phys_run(unode->ump, blob, lsect,
+			    fileblkoff, numb);
+			if (error != 0)
+				return (error);
+		}
+
+		blob += numb;
+		length -= numb;
+		start += numb;
+		fileblk = start / sector_size;
+		fileblkoff = start % sector_size;
+	}
+
+	return (0);
+}
+
+/* completion state of udf_read_node_async() */
+struct udf_async {
+	u_int		  refs;		/* issuer and bios in flight */
+	u_int		  error;
+	void		(*done)(void *, int);
+	void		 *arg;
+};
+
+static void
+udf_async_release(struct udf_async *as)
+{
+
+	if (refcount_release(&as->refs)) {
+		as->done(as->arg, as->error);
+		free(as, M_UDFTEMP);
+	}
+}
+
+static void
+udf_async_biodone(struct bio *bip)
+{
+	struct udf_async *as = bip->bio_caller1;
+	int error;
+
+	error = bip->bio_error;
+	if (error == 0 && bip->bio_completed != bip->bio_length)
+		error = EIO;
+	if (error != 0)
+		atomic_cmpset_int(&as->error, 0, error);
+	g_destroy_bio(bip);
+	udf_async_release(as);
+}
+
+/*
+ * Start reading a sector aligned range of a node straight from the device,
+ * one request per run; holes are zeroed without touching the device.  With
+ * `as' the requests complete through udf_async_biodone(), otherwise they
+ * are chained on `bios' through bio_caller1 for the caller to wait on.
+ */
+static int
+udf_start_node_runs(struct udf_node *unode, uint8_t *blob, off_t start,
+    int length, struct udf_async *as, struct bio **bios)
+{
+	struct udf_mount *ump = unode->ump;
+	struct bio *bip;
+	uint64_t lsect;
+	int error, exttype;
+	uint32_t fileblk, maxsect, numlsect, numsect, sector_size, sectors;
+
+	sector_size = ump->sector_size;
+	maxsect = MAX(1, ump->vfs_mountp->mnt_iosize_max / sector_size);
+
+	fileblk = start / sector_size;
+	numsect = howmany(length, sector_size);
+
+	error = 0;
+	while (numsect > 0) {
+		error = udf_bmap_translate(unode, fileblk, &exttype, &lsect,
+		    &numlsect);
+		if (error != 0)
+			break;
+		numlsect = MIN(numlsect, numsect);
+
+		if (exttype == UDF_TRAN_ZERO)
+			memset(blob, 0, numlsect * sector_size);
+		else if (exttype == UDF_TRAN_INTERN) {
+			error = EDOOFUS;
+			break;
+		} else {
+			for (sectors = 0; sectors < numlsect;
+			    sectors += maxsect) {
+				if (as != NULL)
+					refcount_acquire(&as->refs);
+				bip = udf_start_phys_direct(ump,
+				    blob + sectors * sector_size,
+				    lsect + sectors,
+				    MIN(maxsect, numlsect - sectors),
+				    as != NULL ? udf_async_biodone : NULL,
+				    as != NULL ? (void *)as : *bios);
+				if (as == NULL)
+					*bios = bip;
 			}
 		}
-		
+
+		blob += numlsect * sector_size;
 		fileblk += numlsect;
+		numsect -= numlsect;
+	}
+
+	return (error);
+}
+
+static int
+udf_node_is_intern(struct udf_node *unode, uint64_t *file_size)
+{
+	int icbflags;
+
+	if (unode->fe != NULL) {
+		icbflags = le16toh(unode->fe->icbtag.flags);
+		*file_size = le64toh(unode->fe->inf_len);
+	} else {
+		icbflags = le16toh(unode->efe->icbtag.flags);
+		*file_size = le64toh(unode->efe->inf_len);
+	}
+
+	return ((icbflags & UDF_ICB_TAG_FLAGS_ALLOC_MASK) ==
+	    UDF_ICB_INTERN_ALLOC);
+}
+
+/*
+ * Data of a node with intern allocation lives in its file entry, so it can
+ * be used in place.  *data is set to NULL if the node has extents.
+ */
+int
+udf_intern_data(struct udf_node *unode, uint8_t **data, uint64_t *len)
+{
+	uint32_t l_ad;
+
+	*data = NULL;
+	if (!udf_node_is_intern(unode, len))
+		return (0);
+
+	if (unode->fe != NULL) {
+		*data = &unode->fe->data[0] + le32toh(unode->fe->l_ea);
+		l_ad = le32toh(unode->fe->l_ad);
+	} else {
+		*data = &unode->efe->data[0] + le32toh(unode->efe->l_ea);
+		l_ad = le32toh(unode->efe->l_ad);
+	}
+	if (*len > l_ad) {
+		*data = NULL;
+		return (EIO);
+	}
+
+	return (0);
+}
+
+/*
+ * Like udf_read_node(), but for a sector aligned start: every run of the
+ * range is read straight from the device and all requests are in flight at
+ * once; holes are zeroed without touching the device.  The last sector is
+ * read whole, so blob has to hold length rounded up to the sector size.
+ */
+int
+udf_read_node_direct(struct udf_node *unode, uint8_t *blob, off_t start,
+    int length)
+{
+	struct bio *bip, *bios;
+	uint64_t file_size;
+	int error, werror;
+
+	if (udf_node_is_intern(unode, &file_size))
+		return (udf_read_node(unode, blob, start, length));
+	if ((uint64_t)length > file_size - start)
+		length = file_size - start;
+
+	bios = NULL;
+	error = udf_start_node_runs(unode, blob, start, length, NULL, &bios);
+
+	while ((bip = bios) != NULL) {
+		bios = bip->bio_caller1;
+		werror = udf_wait_phys_direct(bip);
+		if (error == 0)
+			error = werror;
+	}
+
+	return (error);
+}
+
+/*
+ * Asynchronous udf_read_node_direct(): done(arg, error) is called once all
+ * requests have completed, from the I/O completion context or, if nothing
+ * had to be read from the device, before this returns.
+ */
+void
+udf_read_node_async(struct udf_node *unode, uint8_t *blob, off_t start,
+    int length, void (*done)(void *, int), void *arg)
+{
+	struct udf_async *as;
+	uint64_t file_size;
+	int error;
+
+	if (udf_node_is_intern(unode, &file_size)) {
+		done(arg, udf_read_node(unode, blob, start, length));
+		return;
+	}
+	if ((uint64_t)length > file_size - start)
+		length = file_size - start;
+
+	as = malloc(sizeof(struct udf_async), M_UDFTEMP, M_WAITOK);
+	refcount_init(&as->refs, 1);
+	as->error = 0;
+	as->done = done;
+	as->arg = arg;
+
+	error = udf_start_node_runs(unode, blob, start, length, as, NULL);
+	if (error != 0)
+		atomic_cmpset_int(&as->error, 0, error);
+	udf_async_release(as);
+}
+
+/*
+ * Read length bytes, starting offset bytes into physically contiguous run
+ * lsect. Whole sectors are read straight into blob in requests of at most
+ * mnt_iosize_max, only a partial first or last sector is read through the
+ * buffer cache and copied.
+ */
+static int
+udf_read_phys_run(struct udf_mount *ump, uint8_t *blob, uint64_t lsect,
+    uint32_t offset, uint32_t length)
+{
+	struct vnode *devvp = ump->devvp;
+	struct buf *bp;
+	int error;
+	uint32_t blkinsect, maxsect, numb, sector_size, sectors;
+
+	sector_size = ump->sector_size;
+	blkinsect = sector_size / DEV_BSIZE;
+	maxsect = MAX(1, ump->vfs_mountp->mnt_iosize_max / sector_size);
+
+	lsect += offset / sector_size;
+	offset %= sector_size;
+
+	while (length > 0) {
+		if (offset == 0 && length >= sector_size) {
+			sectors = MIN(length / sector_size, maxsect);
+			error = udf_read_phys_direct(ump, blob, lsect, sectors);
+			if (error != 0)
+				return (error);
+			numb = sectors * sector_size;
+		} else {
+			error = bread(devvp, lsect * blkinsect, sector_size,
+			    NOCRED, &bp);
+			if (error != 0) {
+				if (bp != NULL)
+					brelse(bp);
+				return (error);
+			}
+			numb = MIN(length, sector_size - offset);
+			bcopy(bp->b_data + offset, blob, numb);
+			brelse(bp);
+			sectors = 1;
+		}
+
+		blob += numb;
+		length -= numb;
+		lsect += sectors;
+		offset = 0;
 	}
 
 	return (0);
 }
 
+/*
+ * start reading n sectors straight into blob; without a done routine the
+ * caller waits with udf_wait_phys_direct()
+ */
+static struct bio *
+udf_start_phys_direct(struct udf_mount *ump, void *blob, uint64_t start,
+    uint32_t sectors, void (*done)(struct bio *), void *caller1)
+{
+	struct bio *bip;
+
+	bip = g_alloc_bio();
+	bip->bio_cmd = BIO_READ;
+	bip->bio_done = done;
+	bip->bio_caller1 = caller1;
+	bip->bio_offset = start * ump->sector_size;
+	bip->bio_length = (off_t)sectors * ump->sector_size;
+	bip->bio_data = blob;
+
+	g_io_request(bip, ump->geomcp);
+
+	return (bip);
+}
+
+/*
+ * wait for and dispose of a request from udf_start_phys_direct(); GEOM cuts
+ * short a read crossing the end of the media without an error, so a short
+ * read is an error here
+ */
+static int
+udf_wait_phys_direct(struct bio *bip)
+{
+	int error;
+
+	error = biowait(bip, "udfrd");
+	if (error == 0 && bip->bio_completed != bip->bio_length)
+		error = EIO;
+	g_destroy_bio(bip);
+
+	return (error);
+}
+
+/* SYNC reading of n sectors straight into blob, bypassing the buffer cache */
+static int
+udf_read_phys_direct(struct udf_mount *ump, void *blob, uint64_t start,
+    uint32_t sectors)
+{
+	struct bio *bip;
+
+	bip = udf_start_phys_direct(ump, blob, start, sectors, NULL, NULL);
+
+	return (udf_wait_phys_direct(bip));
+}
+
+/*
+ * Descriptor sequences like the VDS and the LVID sequence are read one
+ * descriptor at a time by their parsers. To avoid an I/O per descriptor the
+ * extent is fetched in advance into a window of at most mnt_iosize_max
+ * bytes; udf_read_phys_sectors() serves reads inside the extent from it and
+ * slides the window when a read runs past its end.
+ */
+int
+udf_prefetch_dscrs(struct udf_mount *ump, uint32_t start, uint32_t sectors)
+{
+
+	udf_release_dscrs(ump);
+	if (sectors <= 1)
+		return (0);
+
+	ump->dscr_win_end = start + sectors;
+	return (udf_fill_dscr_window(ump, start));
+}
+
+/*
+ * Prefetch a descriptor sequence and, at the same time, a copy of it to
+ * fall back on, like the main and reserve VDS; udf_switch_dscrs() makes
+ * the copy the sequence that is served.
+ */
+int
+udf_prefetch_dscrs2(struct udf_mount *ump, uint32_t start, uint32_t sectors,
+    uint32_t alt_start, uint32_t alt_sectors)
+{
+	struct bio *bip, *alt_bip;
+	int alt_error, error;
+	uint32_t maxsect, sector_size;
+
+	udf_release_dscrs(ump);
+
+	sector_size = ump->sector_size;
+	maxsect = MAX(1, ump->vfs_mountp->mnt_iosize_max / sector_size);
+
+	bip = alt_bip = NULL;
+	if (sectors > 1) {
+		ump->dscr_win = malloc(maxsect * sector_size, M_UDFTEMP,
+		    M_WAITOK);
+		bip = udf_start_phys_direct(ump, ump->dscr_win, start,
+		    MIN(sectors, maxsect), NULL, NULL);
+	}
+	if (alt_sectors > 1) {
+		ump->dscr_alt = malloc(maxsect * sector_size, M_UDFTEMP,
+		    M_WAITOK);
+		alt_bip = udf_start_phys_direct(ump, ump->dscr_alt, alt_start,
+		    MIN(alt_sectors, maxsect), NULL, NULL);
+	}
+
+	error = alt_error = 0;
+	if (bip != NULL)
+		error = udf_wait_phys_direct(bip);
+	if (alt_bip != NULL)
+		alt_error = udf_wait_phys_direct(alt_bip);
+
+	if (bip != NULL && error == 0) {
+		ump->dscr_win_start = start;
+		ump->dscr_win_len = MIN(sectors, maxsect);
+		ump->dscr_win_end = start + sectors;
+	} else if (ump->dscr_win != NULL) {
+		free(ump->dscr_win, M_UDFTEMP);
+		ump->dscr_win = NULL;
+	}
+	if (alt_bip != NULL && alt_error == 0) {
+		ump->dscr_alt_start = alt_start;
+		ump->dscr_alt_len = MIN(alt_sectors, maxsect);
+		ump->dscr_alt_end = alt_start + alt_sectors;
+	} else if (ump->dscr_alt != NULL) {
+		free(ump->dscr_alt, M_UDFTEMP);
+		ump->dscr_alt = NULL;
+	}
+
+	return (error);
+}
+
+void
+udf_switch_dscrs(struct udf_mount *ump)
+{
+
+	if (ump->dscr_win != NULL)
+		free(ump->dscr_win, M_UDFTEMP);
+	ump->dscr_win = ump->dscr_alt;
+	ump->dscr_win_start = ump->dscr_alt_start;
+	ump->dscr_win_len = ump->dscr_alt_len;
+	ump->dscr_win_end = ump->dscr_alt_end;
+
+	ump->dscr_alt = NULL;
+	ump->dscr_alt_start = ump->dscr_alt_len = ump->dscr_alt_end = 0;
+}
+
+void
+udf_release_dscrs(struct udf_mount *ump)
+{
+
+	if (ump->dscr_win != NULL)
+		free(ump->dscr_win, M_UDFTEMP);
+	ump->dscr_win = NULL;
+	ump->dscr_win_start = ump->dscr_win_len = ump->dscr_win_end = 0;
+
+	if (ump->dscr_alt != NULL)
+		free(ump->dscr_alt, M_UDFTEMP);
+	ump->dscr_alt = NULL;
+	ump->dscr_alt_start = ump->dscr_alt_len = ump->dscr_alt_end = 0;
+}
+
+static int
+udf_fill_dscr_window(struct udf_mount *ump, uint32_t start)
+{
+	int error;
+	uint32_t maxsect, sector_size, sectors;
+
+	sector_size = ump->sector_size;
+	maxsect = MAX(1, ump->vfs_mountp->mnt_iosize_max / sector_size);
+	sectors = MIN(ump->dscr_win_end - start, maxsect);
+
+	if (ump->dscr_win == NULL)
+		ump->dscr_win = malloc(maxsect * sector_size, M_UDFTEMP,
+		    M_WAITOK);
+
+	error = udf_read_phys_direct(ump, ump->dscr_win, start, sectors);
+	if (error != 0) {
+		udf_release_dscrs(ump);
+		return (error);
+	}
+	ump->dscr_win_start = start;
+	ump->dscr_win_len = sectors;
+
+	return (0);
+}
+
 /* SYNC reading of n blocks from specified sector */
 static int
 udf_read_phys_sectors(struct udf_mount *ump, int what, void *blob,
@@ -137,23 +574,39 @@ udf_read_phys_sectors(struct udf_mount *ump, int what, void *blob,
 {
 	struct vnode *devvp = ump->devvp;
 	struct buf *bp;
-	int error = 0;
+	int error;
 	uint32_t blks, sector_size;
 
 	sector_size = ump->sector_size;
 	blks = sector_size / DEV_BSIZE;
 
-	while (sectors > 0 && error == 0) {
+	/* inside a prefetched descriptor sequence? */
+	if (ump->dscr_win != NULL && start >= ump->dscr_win_start &&
+	    start + sectors <= ump->dscr_win_end) {
+		if (start + sectors > ump->dscr_win_start + ump->dscr_win_len) {
+			error = udf_fill_dscr_window(ump, start);
+			if (error != 0)
+				return (error);
+		}
+		if (start + sectors <= ump->dscr_win_start + ump->dscr_win_len) {
+			bcopy(ump->dscr_win +
+			    (start - ump->dscr_win_start) * sector_size,
+			    blob, sectors * sector_size);
+			return (0);
+		}
+	}
+
+	/* single descriptors are read through the buffer cache */
+	while (sectors > 0) {
 		error = bread(devvp, start * blks, sector_size, NOCRED, &bp);
 		if (error != 0) {
-			if (buf != NULL)
+			if (bp != NULL)
 				brelse(bp);
 			return (error);
 		}
 
 		bcopy(bp->b_data, blob, sector_size);
 		brelse(bp);
-		bp = NULL;
 
 		blob = (void *)((uint8_t *)blob + sector_size);
 		start++;
@@ -163,35 +616,52 @@ udf_read_phys_sectors(struct udf_mount *ump, int what, void *blob,
 	return (0);
 }
 
-/* synchronous generic descriptor read */
+/*
+ * check for an all zero sector a word at a time; sectors are a multiple
+ * of the word size and the buffer comes from malloc(9).
+ */
 int
-udf_read_phys_dscr(struct udf_mount *ump, uint32_t sector,
-    struct malloc_type *mtype, union dscrptr **dstp)
+udf_is_blank(void *sector, int sector_size)
 {
-	union dscrptr *dst, *new_dst;
-	int dscrlen, error, i, sectors, sector_size;
+	uint64_t *pos, *end, acc;
+
+	pos = sector;
+	end = pos + sector_size / sizeof(uint64_t);
+	acc = 0;
+	for (; pos < end; pos += 4) {
+		acc |= pos[0] | pos[1] | pos[2] | pos[3];
+		if (acc != 0)
+			return (0);
+	}
+
+	return (1);
+}
+
+/*
+ * Check a descriptor whose first sector has been read into dst, read in
+ * the rest of it and hand it out in *dstp; a blank sector yields no error
+ * and no descriptor.
+ */
+static int
+udf_finish_phys_dscr(struct udf_mount *ump, uint32_t sector,
+    struct malloc_type *mtype, union dscrptr *dst, int error,
+    union dscrptr **dstp)
+{
+	union dscrptr *new_dst;
+	int dscrlen, sectors, sector_size;
 	uint8_t *pos;
 
 	sector_size = ump->sector_size;
 
-	*dstp = dst = NULL;
+	*dstp = NULL;
 	dscrlen = sector_size;
 
-	/* read initial piece */
-	dst = malloc(sector_size, mtype, M_WAITOK);
-	error = udf_read_phys_sectors(ump, UDF_C_DSCR, dst, sector, 1);
-
 	if (error == 0) {
 		/* check if its a valid tag */
 		error = udf_check_tag(dst);
 		if (error != 0) {
 			/* check if its an empty block */
-			pos = (uint8_t *)dst;
-			for (i = 0; i < sector_size; i++, pos++)
-				if (*pos)
-					break;
-
-			if (i == sector_size) {
+			if (udf_is_blank(dst, sector_size)) {
 				/* return no error but with no dscrptr */
 				/* dispose first block */
 				free(dst, mtype);
@@ -232,3 +702,47 @@ udf_read_phys_dscr(struct udf_mount *ump, uint32_t sector,
 
 	return (error);
 }
+
+/* synchronous generic descriptor read */
+int
+udf_read_phys_dscr(struct udf_mount *ump, uint32_t sector,
+    struct malloc_type *mtype, union dscrptr **dstp)
+{
+	union dscrptr *dst;
+	int error;
+
+	/* read initial piece */
+	dst = malloc(ump->sector_size, mtype, M_WAITOK);
+	error = udf_read_phys_sectors(ump, UDF_C_DSCR, dst, sector, 1);
+
+	return (udf_finish_phys_dscr(ump, sector, mtype, dst, error, dstp));
+}
+
+/*
+ * Read the descriptors at n scattered sectors, like the anchors, with all
+ * first sectors in flight at once.  dstp[i] and errors[i] are set as
+ * udf_read_phys_dscr() would for sectors[i].
+ */
+void
+udf_read_phys_dscrs(struct udf_mount *ump, int n, uint32_t *sectors,
+    struct malloc_type *mtype, union dscrptr **dstp, int *errors)
+{
+	struct bio **bips;
+	union dscrptr *dst;
+	int error, i;
+
+	bips = malloc(n * sizeof(struct bio *), M_UDFTEMP, M_WAITOK);
+	for (i = 0; i < n; i++) {
+		dstp[i] = malloc(ump->sector_size, mtype, M_WAITOK);
+		bips[i] = udf_start_phys_direct(ump, dstp[i], sectors[i], 1,
+		    NULL, NULL);
+	}
+
+	for (i = 0; i < n; i++) {
+		error = udf_wait_phys_direct(bips[i]);
+		dst = dstp[i];
+		errors[i] = udf_finish_phys_dscr(ump, sectors[i], mtype, dst,
+		    error, &dstp[i]);
+	}
+	free(bips, M_UDFTEMP);
+}
@@ -30,16 +30,24 @@
 #include <sys/endian.h>
 #include <sys/param.h>
 #include <sys/systm.h>
+#include <sys/kernel.h>
+#include <sys/lock.h>
+#include <sys/mutex.h>
+#include <sys/queue.h>
+#include <sys/sx.h>
 #include <sys/vnode.h>
 #include <sys/malloc.h>
 #include <sys/stat.h>
 #include <sys/mount.h>
+#include <sys/sysctl.h>
 #include <sys/iconv.h>
 
 #include "ecma167-udf.h"
 #include "udf.h"
 #include "udf_subr.h"
 
+SYSCTL_DECL(_vfs_udf2);
+
 #define VTOI(vnode) ((struct udf_node *) (vnode)->v_data)
 
 static int	udf_leapyear(int year);
@@ -53,17 +61,18 @@ int
 udf_check_tag(void *blob)
 {
 	struct desc_tag *tag = blob;
-	uint8_t cnt, *pos, sum;
+	uint64_t lanes, m, w[2];
+	uint8_t sum;
 
-	/* check TAG header checksum */
-	pos = (uint8_t *)tag;
-	sum = 0;
-
-	for (cnt = 0; cnt < 16; cnt++) {
-		if (cnt != 4)
-			sum += *pos;
-		pos++;
-	}
+	/*
+	 * check TAG header checksum; the 16 header bytes are summed a word
+	 * at a time by adding the byte lanes into 16 bit lanes.
+	 */
+	memcpy(w, tag, sizeof(w));
+	m = 0x00ff00ff00ff00ffULL;
+	lanes = (w[0] & m) + ((w[0] >> 8) & m) + (w[1] & m) + ((w[1] >> 8) & m);
+	sum = (lanes * 0x0001000100010001ULL) >> 48;
+	sum -= tag->cksum;
 	if (sum != tag->cksum) {
 		/* bad tag header checksum; this is not a valid tag */
 		return (EINVAL);
@@ -261,32 +270,12 @@ udf_unlock_node(struct udf_node *udf_node, int flag)
 #endif
 }
 
-static int
-udf_read_anchor(struct udf_mount *ump, uint32_t sector, struct anchor_vdp **dst)
-{
-	int error;
-
-	error = udf_read_phys_dscr(ump, sector, M_UDFTEMP,
-	    (union dscrptr **)dst);
-	if (error == 0) {
-		/* blank terminator blocks are not allowed here */
-		if (*dst == NULL)
-			return (ENOENT);
-		if (le16toh((*dst)->tag.id) != TAGID_ANCHOR) {
-			error = ENOENT;
-			free(*dst, M_UDFTEMP);
-			*dst = NULL;
-		}
-	}
-
-	return (error);
-}
-
 int
 udf_read_anchors(struct udf_mount *ump)
 {
 	struct anchor_vdp **anchorsp;
-	int first_anchor, anch, error, ok;
+	union dscrptr *dscrs[4];
+	int errors[4], first_anchor, anch, n, ok;
 	uint32_t positions[4], session_end, session_start;
 
 	session_start = ump->session_start;
@@ -299,19 +288,29 @@ udf_read_anchors(struct udf_mount *ump)
 	/* XXX shouldn't +512 be prefered above +256 for compat with Roxio CD */
 	positions[3] = session_start + 512; /* [UDF 2.60/6.11.2] */
 
-	ok = 0;
-	anchorsp = ump->anchors;
 	first_anchor = 0;
 	if (ump->first_trackblank)
 		first_anchor = 1;
-	for (anch = first_anchor; anch < 4; anch++) {
-		if (positions[anch] <= session_end) {
-			error = udf_read_anchor(ump, positions[anch], anchorsp);
-			if (error == 0) {
-				anchorsp++;
-				ok++;
-			}
+	n = 0;
+	for (anch = first_anchor; anch < 4; anch++)
+		if (positions[anch] <= session_end)
+			positions[n++] = positions[anch];
+
+	/* all anchors are read at once, each is a seek of its own */
+	udf_read_phys_dscrs(ump, n, positions, M_UDFTEMP, dscrs, errors);
+
+	ok = 0;
+	anchorsp = ump->anchors;
+	for (anch = 0; anch < n; anch++) {
+		if (errors[anch] != 0 || dscrs[anch] == NULL)
+			continue;
+		/* blank terminator blocks are not allowed here */
+		if (le16toh(dscrs[anch]->tag.id) != TAGID_ANCHOR) {
+			free(dscrs[anch], M_UDFTEMP);
+			continue;
 		}
+		*anchorsp++ = &dscrs[anch]->avdp;
+		ok++;
 	}
 
 	return (ok);
@@ -394,20 +393,17 @@ udf_read_vds_extent(struct udf_mount *ump, uint32_t loc, uint32_t len)
 	error = EIO;
 	while (len > 0) {
 		error = udf_read_phys_dscr(ump, loc, M_UDFTEMP, &dscr);
-		if (error != 0) {
-			if (!dscr)
-				free(dscr, M_UDFTEMP);
-			return (error);
-		}
+		if (error != 0)
+			break;
 
 		/* blank block is a terminator */
 		if (dscr == NULL)
-			return (0);
+			break;
 
 		/* TERM descriptor is a terminator */
 		if (le16toh(dscr->tag.id) == TAGID_TERM) {
 			free(dscr, M_UDFTEMP);
-			return (0);
+			break;
 		}
 
 		/* process all others */
@@ -459,11 +455,20 @@ udf_read_vds_space(struct udf_mount *ump)
 	reserve_loc = le32toh(anchor->reserve_vds_ex.loc);
 	reserve_len = le32toh(anchor->reserve_vds_ex.len);
 
+	/*
+	 * fetch both extents in one go, so falling back on the reserve costs
+	 * no extra seek; on failure read descriptor by one
+	 */
+	(void)udf_prefetch_dscrs2(ump, main_loc, main_len / ump->sector_size,
+	    reserve_loc, reserve_len / ump->sector_size);
+
 	error = udf_read_vds_extent(ump, main_loc, main_len);
 	if (error != 0) {
 		printf("UDF mount: reading in reserve VDS extent\n");
+		udf_switch_dscrs(ump);
 		error = udf_read_vds_extent(ump, reserve_loc, reserve_len);
 	}
+	udf_release_dscrs(ump);
 
 	return (error);
 }
@@ -494,6 +499,7 @@ udf_retrieve_lvint(struct udf_mount *ump)
 	lvint = NULL;
 	dscr = NULL;
 	error = 0;
+	(void)udf_prefetch_dscrs(ump, lbnum, len / lb_size);
 	while (len > 0) {
 		/* read in our integrity descriptor */
 		error = udf_read_phys_dscr(ump, lbnum, M_UDFTEMP, &dscr);
@@ -526,8 +532,10 @@ udf_retrieve_lvint(struct udf_mount *ump)
 		if (dscr && lvint->next_extent.len) {
 			len = le32toh(lvint->next_extent.len);
 			lbnum = le32toh(lvint->next_extent.loc);
+			(void)udf_prefetch_dscrs(ump, lbnum, len / lb_size);
 		}
 	}
+	udf_release_dscrs(ump);
 
 	/* clean up the mess, esp. when there is an error */
 	if (dscr)
@@ -559,7 +567,7 @@ udf_process_vds(struct udf_mount *ump) {
 	struct udf_logvol_info *lvinfo;
 	int error, log_part, phys_part, pmap_size, pmap_stype, pmap_type;
 	int len, n_meta, n_phys, n_spar, n_virt, raw_phys_part;
-	uint32_t mt_l, n_pm;
+	uint32_t n_pm;
 	char *domain_name, *map_name; /* bits[128]; */
 	const char *check_name;
 	uint8_t *pmap_pos;
@@ -608,7 +616,6 @@ udf_process_vds(struct udf_mount *ump) {
 	 * strncmp() in tight places.
 	 */
 	n_pm = le32toh(ump->logical_vol->n_pm);   /* num partmaps         */
-	mt_l = le32toh(ump->logical_vol->mt_l);   /* partmaps data length */
 	pmap_pos = ump->logical_vol->maps;
 
 	if (n_pm > UDF_PMAPS) {
@@ -945,15 +952,247 @@ udf_update_lvid_from_vat_extattr(struct udf_node *vat_node)
 	return (0);
 }
 
+/*
+ * The VAT can also be loaded on demand: pages are read in on their first
+ * lookup and the least recently used are dropped again to keep a volume
+ * within vfs.udf2.vat_maxmem.  Pages without mapped entries point to
+ * udf_vat_hole so they are not read again.
+ */
+static int udf_vat_lazy = 0;
+SYSCTL_INT(_vfs_udf2, OID_AUTO, vat_lazy, CTLFLAG_RW, &udf_vat_lazy, 0,
+    "read the VAT in on demand");
+
+static long udf_vat_maxmem = 8 * 1024 * 1024;
+SYSCTL_LONG(_vfs_udf2, OID_AUTO, vat_maxmem, CTLFLAG_RW, &udf_vat_maxmem, 0,
+    "maximum resident VAT per volume when read in on demand");
+
+static uint32_t udf_vat_hole[1];
+
+/* bookkeeping of a VAT read in on demand */
+struct udf_vat_lru {
+	TAILQ_ENTRY(udf_vat_lru) link;
+};
+
+struct udf_vat_demand {
+	struct sx		 lock;		/* guards vat_pages    */
+	struct mtx		 lru_mtx;	/* guards lru          */
+	TAILQ_HEAD(, udf_vat_lru) lru;		/* oldest first        */
+	struct udf_vat_lru	*ents;		/* one per page        */
+	uint32_t		 resident;	/* pages read in       */
+};
+
+static long udf_vat_mem;
+SYSCTL_LONG(_vfs_udf2, OID_AUTO, vat_mem, CTLFLAG_RD, &udf_vat_mem, 0,
+    "memory used by the VATs of mounted volumes");
+
+static void
+udf_account_vat(struct udf_mount *ump, long size)
+{
+
+	ump->vat_memused += size;
+	atomic_add_long(&udf_vat_mem, size);
+}
+
+void
+udf_free_vat(struct udf_mount *ump)
+{
+	uint32_t i;
+
+	if (ump->vat_node != NULL) {
+		udf_dispose_node(ump->vat_node);
+		ump->vat_node = NULL;
+		sx_destroy(&ump->vat_demand->lock);
+		mtx_destroy(&ump->vat_demand->lru_mtx);
+		free(ump->vat_demand->ents, M_UDFTEMP);
+		free(ump->vat_demand, M_UDFTEMP);
+		ump->vat_demand = NULL;
+	}
+	udf_account_vat(ump, -ump->vat_memused);
+
+	if (ump->vat_pages == NULL)
+		return;
+
+	for (i = 0; i < ump->vat_npages; i++)
+		if (ump->vat_pages[i] != NULL &&
+		    ump->vat_pages[i] != udf_vat_hole)
+			free(ump->vat_pages[i], M_UDFTEMP);
+	free(ump->vat_pages, M_UDFTEMP);
+	ump->vat_pages = NULL;
+	ump->vat_npages = 0;
+}
+
+/*
+ * Read VAT page p in host-endian order; *pagep is NULL if the page only
+ * holds unmapped entries.
+ */
+static int
+udf_read_vat_page(struct udf_mount *ump, struct udf_node *vat_node,
+    uint32_t p, uint32_t **pagep)
+{
+	uint32_t *page;
+	uint32_t i, n;
+	int error, mapped;
+
+	*pagep = NULL;
+	n = MIN(ump->vat_entries - p * UDF_VAT_PAGE_ENTRIES,
+	    UDF_VAT_PAGE_ENTRIES);
+
+	page = malloc(UDF_VAT_CHUNKSIZE, M_UDFTEMP, M_WAITOK);
+	error = udf_read_node(vat_node, (uint8_t *)page,
+	    ump->vat_offset + (off_t)p * UDF_VAT_CHUNKSIZE, n * 4);
+	if (error != 0) {
+		free(page, M_UDFTEMP);
+		return (error);
+	}
+
+	mapped = 0;
+	for (i = 0; i < n; i++) {
+		page[i] = le32toh(page[i]);
+		if (page[i] != UDF_VAT_UNMAPPED)
+			mapped = 1;
+	}
+	if (!mapped) {
+		free(page, M_UDFTEMP);
+		return (0);
+	}
+
+	/* pad the last page so lookups need no extra check */
+	for (; i < UDF_VAT_PAGE_ENTRIES; i++)
+		page[i] = UDF_VAT_UNMAPPED;
+
+	udf_account_vat(ump, UDF_VAT_CHUNKSIZE);
+	*pagep = page;
+	return (0);
+}
+
+/*
+ * Read the VAT entries into host-endian pages of UDF_VAT_PAGE_ENTRIES.
+ * Pages that only hold unmapped entries are not stored, so a VAT never
+ * needs one large allocation.
+ */
+static int
+udf_load_vat_pages(struct udf_node *vat_node)
+{
+	struct udf_mount *ump = vat_node->ump;
+	struct udf_vat_demand *vd;
+	uint32_t p;
+	int error;
+
+	ump->vat_npages = howmany(ump->vat_entries, UDF_VAT_PAGE_ENTRIES);
+	ump->vat_pages = malloc(MAX(ump->vat_npages, 1) * sizeof(uint32_t *),
+	    M_UDFTEMP, M_WAITOK | M_ZERO);
+	udf_account_vat(ump, MAX(ump->vat_npages, 1) * sizeof(uint32_t *));
+
+	/* on demand, only the bookkeeping is set up here */
+	if (udf_vat_lazy) {
+		vd = malloc(sizeof(struct udf_vat_demand), M_UDFTEMP,
+		    M_WAITOK | M_ZERO);
+		sx_init(&vd->lock, "udf vat");
+		mtx_init(&vd->lru_mtx, "udf vat lru", NULL, MTX_DEF);
+		TAILQ_INIT(&vd->lru);
+		vd->ents = malloc(MAX(ump->vat_npages, 1) *
+		    sizeof(struct udf_vat_lru), M_UDFTEMP, M_WAITOK | M_ZERO);
+		udf_account_vat(ump, sizeof(struct udf_vat_demand) +
+		    MAX(ump->vat_npages, 1) * sizeof(struct udf_vat_lru));
+		ump->vat_demand = vd;
+		ump->vat_node = vat_node;
+		return (0);
+	}
+
+	error = 0;
+	for (p = 0; p < ump->vat_npages; p++) {
+		error = udf_read_vat_page(ump, vat_node, p,
+		    &ump->vat_pages[p]);
+		if (error != 0)
+			break;
+	}
+
+	if (error != 0)
+		udf_free_vat(ump);
+
+	return (error);
+}
+
+/*
+ * read in VAT page p, dropping the least recently used pages first to make
+ * room; exclusive lock held, so the LRU list needs no lock of its own
+ */
+static int
+udf_fault_vat_page(struct udf_mount *ump, uint32_t p)
+{
+	struct udf_vat_demand *vd = ump->vat_demand;
+	struct udf_vat_lru *victim;
+	uint32_t *page;
+	uint32_t maxpages, v;
+	int error;
+
+	if (ump->vat_pages[p] != NULL)
+		return (0);
+
+	maxpages = MAX(1, udf_vat_maxmem / UDF_VAT_CHUNKSIZE);
+	while (vd->resident >= maxpages) {
+		victim = TAILQ_FIRST(&vd->lru);
+		if (victim == NULL)
+			break;
+		TAILQ_REMOVE(&vd->lru, victim, link);
+		v = victim - vd->ents;
+		free(ump->vat_pages[v], M_UDFTEMP);
+		ump->vat_pages[v] = NULL;
+		vd->resident--;
+		udf_account_vat(ump, -UDF_VAT_CHUNKSIZE);
+	}
+
+	error = udf_read_vat_page(ump, ump->vat_node, p, &page);
+	if (error != 0)
+		return (error);
+
+	if (page == NULL) {
+		ump->vat_pages[p] = udf_vat_hole;
+	} else {
+		ump->vat_pages[p] = page;
+		TAILQ_INSERT_TAIL(&vd->lru, &vd->ents[p], link);
+		vd->resident++;
+	}
+
+	return (0);
+}
+
+/* look up a VAT entry of a VAT that is read in on demand */
 int
-udf_vat_read(struct udf_mount *ump, uint8_t *blob, int size, 
-    uint32_t offset)
+udf_lookup_vat(struct udf_mount *ump, uint32_t lb_num, uint32_t *entry)
 {
-/*	mutex_enter(&ump->allocate_mutex); */
-	if (offset + size > ump->vat_offset + ump->vat_entries * 4)
-		return (EINVAL);
-	memcpy(blob, ump->vat_table + offset, size);
-/*	mutex_exit(&ump->allocate_mutex); */
+	struct udf_vat_demand *vd = ump->vat_demand;
+	uint32_t *page;
+	uint32_t p;
+	int error;
+
+	p = lb_num / UDF_VAT_PAGE_ENTRIES;
+
+	sx_slock(&vd->lock);
+	page = ump->vat_pages[p];
+	if (page == NULL) {
+		sx_sunlock(&vd->lock);
+		sx_xlock(&vd->lock);
+		error = udf_fault_vat_page(ump, p);
+		if (error != 0) {
+			sx_xunlock(&vd->lock);
+			return (error);
+		}
+		sx_downgrade(&vd->lock);
+		page = ump->vat_pages[p];
+	}
+
+	if (page == udf_vat_hole) {
+		*entry = UDF_VAT_UNMAPPED;
+	} else {
+		/* most recently used to the tail */
+		mtx_lock(&vd->lru_mtx);
+		TAILQ_REMOVE(&vd->lru, &vd->ents[p], link);
+		TAILQ_INSERT_TAIL(&vd->lru, &vd->ents[p], link);
+		mtx_unlock(&vd->lru_mtx);
+		*entry = page[lb_num % UDF_VAT_PAGE_ENTRIES];
+	}
+	sx_sunlock(&vd->lock);
 
 	return (0);
 }
@@ -972,14 +1211,14 @@ udf_check_for_vat(struct udf_node *vat_node)
 	struct udf_vat   *vat;
 	struct udf_oldvat_tail *oldvat_tl;
 	struct udf_logvol_info *lvinfo;
-	uint64_t  unique_id;
+	uint64_t  unique_id, inf_len;
 	int error, filetype;
-	uint32_t vat_entries, vat_length, vat_offset, vat_table_alloc_len;
+	uint32_t log_part, max_entries, n_pm, vat_entries, vat_length;
+	uint32_t vat_offset;
 	uint32_t *raw_vat, sector_size;
 	char *regid_name;
-	uint8_t *vat_table;
 
-	/* vat_length is really 64 bits though impossible */
+	/* vat_length is really 64 bits though impossible, checked below */
 
 	if (vat_node == NULL)
 		return (ENOENT);
@@ -990,12 +1229,12 @@ udf_check_for_vat(struct udf_node *vat_node)
 
 	/* get information from fe/efe */
 	if (vat_node->fe != NULL) {
-		vat_length = le64toh(vat_node->fe->inf_len);
+		inf_len = le64toh(vat_node->fe->inf_len);
 		icbtag = &vat_node->fe->icbtag;
 		mtime = &vat_node->fe->mtime;
 		unique_id = le64toh(vat_node->fe->unique_id);
 	} else {
-		vat_length = le64toh(vat_node->efe->inf_len);
+		inf_len = le64toh(vat_node->efe->inf_len);
 		icbtag = &vat_node->efe->icbtag;
 		mtime = &vat_node->efe->mtime;
 		unique_id = le64toh(vat_node->efe->unique_id);
@@ -1006,16 +1245,12 @@ udf_check_for_vat(struct udf_node *vat_node)
 	if ((filetype != 0) && (filetype != UDF_ICB_FILETYPE_VAT))
 		return (ENOENT);
 
-	vat_table_alloc_len =
-		((vat_length + UDF_VAT_CHUNKSIZE - 1) / UDF_VAT_CHUNKSIZE)
-			* UDF_VAT_CHUNKSIZE;
-
-	if (vat_table_alloc_len > UDF_VAT_ALLOC_LIMIT) {
-		printf("UDF mount: VAT table length of %d bytes exceeds "
-		    "implementation limit.\n", vat_table_alloc_len);
+	if (inf_len > UINT32_MAX) {
+		printf("UDF mount: VAT table length of %ju bytes exceeds "
+		    "implementation limit.\n", (uintmax_t)inf_len);
 		return (ENOMEM);
 	}
-	vat_table = malloc(vat_table_alloc_len, M_UDFTEMP, M_WAITOK); 
+	vat_length = inf_len;
 
 	/* allocate piece to read in head or tail of VAT file */
 	raw_vat = malloc(sector_size, M_UDFTEMP, M_WAITOK);
@@ -1031,6 +1266,10 @@ udf_check_for_vat(struct udf_node *vat_node)
 	if (filetype == 0) {
 		/* definition */
 		vat_offset = 0;
+		if (vat_length < 36) {
+			error = ENOENT;
+			goto out;
+		}
 		vat_entries = (vat_length - 36) / 4;
 
 		/* read in tail of virtual allocation table file */
@@ -1062,7 +1301,11 @@ udf_check_for_vat(struct udf_node *vat_node)
 
 		/* definition */
 		vat = (struct udf_vat *)raw_vat;
-		vat_offset = vat->header_len;
+		vat_offset = le16toh(vat->header_len);
+		if (vat_length < vat_offset) {
+			error = ENOENT;
+			goto out;
+		}
 		vat_entries = (vat_length - vat_offset) / 4;
 
 		lvinfo->num_files = vat->num_files;
@@ -1074,8 +1317,29 @@ udf_check_for_vat(struct udf_node *vat_node)
 		udf_update_logvolname(ump, vat->logvol_id);
 	}
 
+	/*
+	 * Every virtual block maps onto a block of the physical partition and
+	 * of the media, so a longer VAT is corrupt; recorded as unallocated it
+	 * would read back as zeros and only make us allocate memory for it.
+	 * This also bounds the size of the page table.
+	 */
+	max_entries = ump->session_end;
+	n_pm = le32toh(ump->logical_vol->n_pm);
+	for (log_part = 0; log_part < n_pm; log_part++)
+		if (ump->vtop_tp[log_part] == UDF_VTOP_TYPE_VIRT)
+			max_entries = MIN(max_entries, le32toh(
+			    ump->partitions[ump->vtop[log_part]]->part_len));
+	if (vat_entries > max_entries) {
+		printf("UDF mount: VAT of %u entries exceeds its partition.\n",
+		    vat_entries);
+		error = EINVAL;
+		goto out;
+	}
+
 	/* read in complete VAT file */
-	error = udf_read_node(vat_node, vat_table, 0, vat_length);
+	ump->vat_offset = vat_offset;
+	ump->vat_entries = vat_entries;
+	error = udf_load_vat_pages(vat_node);
 	if (error != 0)
 		printf("UDF mount: Error reading in of complete VAT file."
 		    " (error %d)\n", error);
@@ -1086,77 +1350,226 @@ udf_check_for_vat(struct udf_node *vat_node)
 	ump->logvol_integrity->integrity_type = htole32(UDF_INTEGRITY_CLOSED);
 	ump->logvol_integrity->time = *mtime;
 
-	ump->vat_table_alloc_len = vat_table_alloc_len;
-	ump->vat_table = vat_table;
-	ump->vat_offset = vat_offset;
-	ump->vat_entries = vat_entries;
-
 out:
-	if (error != 0) {
-		if (vat_table != NULL)
-			free(vat_table, M_UDFTEMP);
-	}
 	free(raw_vat, M_UDFTEMP);
 
 	return (error);
 }
 
+/*
+ * The VAT is searched backwards from the last written sector in chunks read
+ * with one request each.  Where it was found is remembered per volume, so a
+ * remount of an unchanged disc goes straight to it.
+ */
+static u_int udf_vat_search_window = 1024;
+SYSCTL_UINT(_vfs_udf2, OID_AUTO, vat_search_window, CTLFLAG_RW,
+    &udf_vat_search_window, 0, "sectors searched backwards for the VAT");
+
+struct udf_vat_hint {
+	char		 volset_id[128];
+	char		 logvol_id[128];
+	uint32_t	 last_written;
+	uint32_t	 vat_loc;
+};
+
+#define UDF_VAT_HINTS	16
+
+static struct udf_vat_hint udf_vat_hints[UDF_VAT_HINTS];
+static int udf_vat_hint_next;
+static struct mtx udf_vat_hint_mtx;
+MTX_SYSINIT(udf_vat_hint, &udf_vat_hint_mtx, "udf vat hints", MTX_DEF);
+
+static struct udf_vat_hint *
+udf_find_vat_hint(struct udf_mount *ump)
+{
+	struct udf_vat_hint *hint;
+	int i;
+
+	for (i = 0; i < UDF_VAT_HINTS; i++) {
+		hint = &udf_vat_hints[i];
+		if (hint->last_written == ump->session_last_written &&
+		    memcmp(hint->volset_id, ump->primary_vol->volset_id,
+		    sizeof(hint->volset_id)) == 0 &&
+		    memcmp(hint->logvol_id, ump->logical_vol->logvol_id,
+		    sizeof(hint->logvol_id)) == 0)
+			return (hint);
+	}
+
+	return (NULL);
+}
+
 static int
-udf_search_vat(struct udf_mount *ump)
+udf_get_vat_hint(struct udf_mount *ump, uint32_t *vat_loc)
+{
+	struct udf_vat_hint *hint;
+
+	mtx_lock(&udf_vat_hint_mtx);
+	hint = udf_find_vat_hint(ump);
+	if (hint != NULL)
+		*vat_loc = hint->vat_loc;
+	mtx_unlock(&udf_vat_hint_mtx);
+
+	return (hint != NULL);
+}
+
+static void
+udf_set_vat_hint(struct udf_mount *ump, uint32_t vat_loc)
+{
+	struct udf_vat_hint *hint;
+
+	mtx_lock(&udf_vat_hint_mtx);
+	hint = udf_find_vat_hint(ump);
+	if (hint == NULL) {
+		hint = &udf_vat_hints[udf_vat_hint_next];
+		udf_vat_hint_next = (udf_vat_hint_next + 1) % UDF_VAT_HINTS;
+		memcpy(hint->volset_id, ump->primary_vol->volset_id,
+		    sizeof(hint->volset_id));
+		memcpy(hint->logvol_id, ump->logical_vol->logvol_id,
+		    sizeof(hint->logvol_id));
+		hint->last_written = ump->session_last_written;
+	}
+	hint->vat_loc = vat_loc;
+	mtx_unlock(&udf_vat_hint_mtx);
+}
+
+/* check for a VAT file entry at vat_loc and load the VAT if it is one */
+static int
+udf_load_vat_at(struct udf_mount *ump, uint32_t vat_loc)
 {
-	union dscrptr *dscr;
 	struct long_ad icb_loc;
 	struct udf_node *vat_node;
 	int error;
-	uint32_t early_vat_loc, vat_loc;
+
+	memset(&icb_loc, 0, sizeof(icb_loc));
+	icb_loc.loc.part_num = htole16(UDF_VTOP_RAWPART);
+	icb_loc.loc.lb_num = htole32(vat_loc);
+
+	vat_node = NULL;
+	error = udf_get_node(ump, icb_loc, &vat_node);
+	if (error == 0)
+		error = udf_check_for_vat(vat_node);
+	/* a VAT read in on demand keeps its node */
+	if (vat_node != NULL && vat_node != ump->vat_node)
+		udf_dispose_node(vat_node);
+
+	return (error);
+}
+
+static int
+udf_search_vat(struct udf_mount *ump)
+{
+	union dscrptr *dscr;
+	int found;
+	uint32_t chunk, early_vat_loc, end, last_vat_loc, start, vat_loc;
 	uint16_t tagid;
 	uint8_t file_type;
 
-	vat_node = NULL;
+	/* the reported last written sector can be past the session */
+	last_vat_loc = ump->last_possible_vat_location;
+	if (last_vat_loc >= ump->session_end && ump->session_end > 0)
+		last_vat_loc = ump->session_end - 1;
+	early_vat_loc = ump->session_start;
+
+	/* a last written sector before the session leaves nothing to scan */
+	if (last_vat_loc < early_vat_loc || last_vat_loc == UINT32_MAX) {
+		printf("UDF mount: VAT not found at last written location\n");
+		return (ENOENT);
+	}
+	if (last_vat_loc - early_vat_loc > udf_vat_search_window)
+		early_vat_loc = last_vat_loc - udf_vat_search_window;
+	ump->first_possible_vat_location = early_vat_loc;
+
+	if (udf_get_vat_hint(ump, &vat_loc) && vat_loc >= early_vat_loc &&
+	    vat_loc <= last_vat_loc && udf_load_vat_at(ump, vat_loc) == 0)
+		return (0);
 
-	early_vat_loc = ump->first_possible_vat_location;
-	vat_loc = ump->last_possible_vat_location;
+	chunk = MAX(1, ump->vfs_mountp->mnt_iosize_max / ump->sector_size);
 
 	/* start looking from the end of the range */
-	do {
-		error = udf_read_phys_dscr(ump, vat_loc, M_UDFTEMP, &dscr);
-		if (!error && dscr) { /* dscr will be null if zeros were read */
-			tagid = le16toh(dscr->tag.id);
+	found = 0;
+	vat_loc = last_vat_loc;
+	for (end = last_vat_loc + 1; !found && end > early_vat_loc;
+	    end = start) {
+		start = end - MIN(end - early_vat_loc, chunk);
+		(void)udf_prefetch_dscrs(ump, start, end - start);
+
+		for (vat_loc = end - 1; ; vat_loc--) {
 			file_type = 0;
-			if (tagid == TAGID_FENTRY)
-			    file_type = dscr->fe.icbtag.file_type;
-			else if (tagid == TAGID_EXTFENTRY)
-			    file_type = dscr->efe.icbtag.file_type; 
-			free(dscr, M_UDFTEMP);
+			/* dscr will be null if zeros were read */
+			if (udf_read_phys_dscr(ump, vat_loc, M_UDFTEMP,
+			    &dscr) == 0 && dscr != NULL) {
+				tagid = le16toh(dscr->tag.id);
+				if (tagid == TAGID_FENTRY)
+					file_type = dscr->fe.icbtag.file_type;
+				else if (tagid == TAGID_EXTFENTRY)
+					file_type = dscr->efe.icbtag.file_type;
+				free(dscr, M_UDFTEMP);
+			}
 
-			if (file_type == 248)
-			{
-				icb_loc.loc.part_num = 
-				    htole16(UDF_VTOP_RAWPART);
-				icb_loc.loc.lb_num = htole32(vat_loc);
-				error = udf_get_node(ump, icb_loc, &vat_node);
-				if (error == 0)
-					error = udf_check_for_vat(vat_node);
-				if (error == 0) {
-					udf_dispose_node(vat_node);
+			if (file_type == UDF_ICB_FILETYPE_VAT) {
+				if (udf_load_vat_at(ump, vat_loc) == 0) {
+					found = 1;
 					break;
 				}
+				/* reading the node can move the window */
+				if (vat_loc > start)
+					(void)udf_prefetch_dscrs(ump, start,
+					    vat_loc - start);
 			}
+			if (vat_loc == start)
+				break;
 		}
+	}
+	udf_release_dscrs(ump);
 
-		if (vat_node != NULL) {
-			udf_dispose_node(vat_node);
-			vat_node = NULL;
-		}
+	if (!found || vat_loc != last_vat_loc)
+		printf("UDF mount: VAT not found at last written location\n");
+	if (!found)
+		return (ENOENT);
 
-		if (vat_loc == ump->last_possible_vat_location)
-			printf("UDF mount: VAT not found at last written "
-			    "location\n");
+	udf_set_vat_hint(ump, vat_loc);
+	return (0);
+}
 
-		vat_loc--;
-	} while (vat_loc >= early_vat_loc);
+static int
+udf_sparing_ent_cmp(const void *a, const void *b)
+{
+	const struct udf_sparing_ent *sa = a, *sb = b;
 
-	return (error);
+	if (sa->org < sb->org)
+		return (-1);
+	return (sa->org > sb->org);
+}
+
+/*
+ * Convert the sparing table into a sorted host-endian array for lookup in
+ * udf_translate_vtop(); entries marking available or defective packets
+ * are left out.
+ */
+void
+udf_build_sparing_map(struct udf_mount *ump)
+{
+	struct udf_sparing_table *spt = ump->sparing_table;
+	struct udf_sparing_ent *ent;
+	uint32_t i, org, rt_l;
+
+	rt_l = le16toh(spt->rt_l);
+	ump->sparing_map = malloc(MAX(rt_l, 1) * sizeof(struct udf_sparing_ent),
+	    M_UDFTEMP, M_WAITOK);
+
+	ent = ump->sparing_map;
+	for (i = 0; i < rt_l; i++) {
+		org = le32toh(spt->entries[i].org);
+		if (org >= 0xfffffff0)
+			continue;
+		ent->org = org;
+		ent->map = le32toh(spt->entries[i].map);
+		ent++;
+	}
+	ump->sparing_map_len = ent - ump->sparing_map;
+
+	qsort(ump->sparing_map, ump->sparing_map_len,
+	    sizeof(struct udf_sparing_ent), udf_sparing_ent_cmp);
 }
 
 static int
@@ -1191,8 +1604,12 @@ udf_read_sparables(struct udf_mount *ump, union udf_pmap *mapping)
 			free(dscr, M_UDFTEMP);
 	}
 
-	if (ump->sparing_table)
+	if (ump->sparing_table) {
+		if (ump->sparing_map != NULL)
+			free(ump->sparing_map, M_UDFTEMP);
+		udf_build_sparing_map(ump);
 		return (0);
+	}
 
 	return (ENOENT);
 }
@@ -1217,10 +1634,14 @@ udf_read_metadata_nodes(struct udf_mount *ump, union udf_pmap *mapping)
 	icb_loc.loc.lb_num = pmm->meta_file_lbn;
 	udf_get_node(ump, icb_loc, &ump->metadata_node);
 
+	/* the mirror backs up translations the main file can't do */
+	icb_loc.loc.lb_num = pmm->meta_mirror_file_lbn;
+	if (icb_loc.loc.lb_num != -1)
+		udf_get_node(ump, icb_loc, &ump->metadata_mirror_node);
+
 	if (ump->metadata_node == NULL) {
-		icb_loc.loc.lb_num = pmm->meta_mirror_file_lbn;
-		if (icb_loc.loc.lb_num != -1)
-			udf_get_node(ump, icb_loc, &ump->metadata_node);
+		ump->metadata_node = ump->metadata_mirror_node;
+		ump->metadata_mirror_node = NULL;
 		
 		if (ump->metadata_node != NULL)
 			printf("UDF mount: Metadata file not readable, "
@@ -1239,14 +1660,13 @@ udf_read_vds_tables(struct udf_mount *ump)
 {
 	union udf_pmap *mapping;
 	int pmap_size, error;
-	uint32_t log_part, mt_l, n_pm;
+	uint32_t log_part, n_pm;
 	uint8_t *pmap_pos;
 
 	error = 0;
 
 	/* Iterate (again) over the part mappings for locations   */
 	n_pm = le32toh(ump->logical_vol->n_pm);   /* num partmaps         */
-	mt_l = le32toh(ump->logical_vol->mt_l);   /* partmaps data length */
 	pmap_pos = ump->logical_vol->maps;
 
 	for (log_part = 0; log_part < n_pm; log_part++) {
@@ -1301,6 +1721,12 @@ udf_read_rootdirs(struct udf_mount *ump)
 	fsd_loc = ump->logical_vol->lv_fsd_loc;
 	fsd_len = le32toh(fsd_loc.len);
 
+	/* fetch the (normally physically contiguous) sequence in advance */
+	error = udf_translate_vtop(ump, &fsd_loc, &lb_num, &dummy);
+	if (error == 0)
+		(void)udf_prefetch_dscrs(ump, lb_num,
+		    MIN(fsd_len / ump->sector_size, dummy));
+
 	dscr = NULL;
 	error = 0;
 	while (fsd_len > 0 || error != 0) {
@@ -1345,6 +1771,7 @@ udf_read_rootdirs(struct udf_mount *ump)
 			fsd_len = le32toh(ump->fileset_desc->next_ex.len);
 		}
 	}
+	udf_release_dscrs(ump);
 	if (dscr != NULL)
 		free(dscr, M_UDFTEMP);
 
@@ -1412,6 +1839,326 @@ udf_read_rootdirs(struct udf_mount *ump)
 	return (0);
 }
 
+/*
+ * Snapshots of what udf_read_vds_tables() derives from a volume.
+ * Jukeboxes remount the same discs all day; when the anchors, VDS and
+ * integrity sequence show a volume is unchanged and its sparing table
+ * still matches, the VAT is taken from the snapshot instead of being
+ * searched for and read in again.  Volumes with a metadata partition hold
+ * nodes and are not kept.
+ */
+struct udf_snapshot {
+	TAILQ_ENTRY(udf_snapshot) link;
+	struct udf_volkey	 key;
+	struct logvol_desc	*logical_vol;
+	struct logvol_int_desc	*logvol_integrity;
+	struct udf_sparing_table *sparing_table;
+	uint32_t		 vat_entries;
+	uint32_t		 vat_offset;
+	uint32_t		 vat_npages;
+	uint32_t		**vat_pages;
+	long			 memused;
+};
+
+static int udf_snapshots_max = 0;
+SYSCTL_INT(_vfs_udf2, OID_AUTO, snapshots, CTLFLAG_RW, &udf_snapshots_max,
+    0, "volumes kept for fast remounting, 0 disables");
+
+static long udf_snapshot_maxmem = 16 * 1024 * 1024;
+SYSCTL_LONG(_vfs_udf2, OID_AUTO, snapshot_maxmem, CTLFLAG_RW,
+    &udf_snapshot_maxmem, 0, "maximum memory used by volume snapshots");
+
+static long udf_snapshot_mem;
+SYSCTL_LONG(_vfs_udf2, OID_AUTO, snapshot_mem, CTLFLAG_RD,
+    &udf_snapshot_mem, 0, "memory used by volume snapshots");
+
+/* most recently used first; list and counts change under the lock */
+static TAILQ_HEAD(udf_snapshot_head, udf_snapshot) udf_snapshots =
+    TAILQ_HEAD_INITIALIZER(udf_snapshots);
+static int udf_nsnapshots;
+static struct sx udf_snapshot_lock;
+SX_SYSINIT(udf_snapshot, &udf_snapshot_lock, "udf snapshots");
+
+static void *
+udf_dup_dscr(void *dscr, uint32_t sector_size, long *memused)
+{
+	void *copy;
+	uint32_t size;
+
+	if (dscr == NULL)
+		return (NULL);
+
+	size = udf_tagsize(dscr, sector_size);
+	copy = malloc(size, M_UDFTEMP, M_WAITOK);
+	memcpy(copy, dscr, size);
+	if (memused != NULL)
+		*memused += size;
+
+	return (copy);
+}
+
+static uint32_t **
+udf_dup_vat(uint32_t **pages, uint32_t npages, long *memused)
+{
+	uint32_t **copy;
+	uint32_t i;
+
+	if (pages == NULL)
+		return (NULL);
+
+	copy = malloc(MAX(npages, 1) * sizeof(uint32_t *), M_UDFTEMP,
+	    M_WAITOK | M_ZERO);
+	*memused += MAX(npages, 1) * sizeof(uint32_t *);
+	for (i = 0; i < npages; i++) {
+		if (pages[i] == NULL)
+			continue;
+		copy[i] = malloc(UDF_VAT_CHUNKSIZE, M_UDFTEMP, M_WAITOK);
+		memcpy(copy[i], pages[i], UDF_VAT_CHUNKSIZE);
+		*memused += UDF_VAT_CHUNKSIZE;
+	}
+
+	return (copy);
+}
+
+static void
+udf_free_snapshot(struct udf_snapshot *snap)
+{
+	uint32_t i;
+
+	free(snap->logical_vol, M_UDFTEMP);
+	free(snap->logvol_integrity, M_UDFTEMP);
+	free(snap->sparing_table, M_UDFTEMP);
+	if (snap->vat_pages != NULL) {
+		for (i = 0; i < snap->vat_npages; i++)
+			free(snap->vat_pages[i], M_UDFTEMP);
+		free(snap->vat_pages, M_UDFTEMP);
+	}
+	free(snap, M_UDFTEMP);
+}
+
+/* drop snapshots from the tail until the limits are met; lock held */
+static void
+udf_trim_snapshots(int max, long maxmem)
+{
+	struct udf_snapshot *snap;
+
+	while (udf_nsnapshots > max || udf_snapshot_mem > maxmem) {
+		snap = TAILQ_LAST(&udf_snapshots, udf_snapshot_head);
+		TAILQ_REMOVE(&udf_snapshots, snap, link);
+		udf_nsnapshots--;
+		atomic_add_long(&udf_snapshot_mem, -snap->memused);
+		udf_free_snapshot(snap);
+	}
+}
+
+void
+udf_free_snapshots(void)
+{
+
+	sx_xlock(&udf_snapshot_lock);
+	udf_trim_snapshots(0, 0);
+	sx_xunlock(&udf_snapshot_lock);
+}
+
+static struct udf_snapshot *
+udf_find_snapshot(struct udf_volkey *key)
+{
+	struct udf_snapshot *snap;
+
+	TAILQ_FOREACH(snap, &udf_snapshots, link)
+		if (memcmp(&snap->key, key, sizeof(*key)) == 0)
+			return (snap);
+
+	return (NULL);
+}
+
+/*
+ * The sparing table holds the defects of one particular disc while discs
+ * burned from the same image share everything else, so it is read in again
+ * and has to match the one kept.  Reading it is disc I/O and is done
+ * without the snapshot lock held.
+ */
+static int
+udf_read_snapshot_sparing(struct udf_mount *ump)
+{
+	union udf_pmap *mapping;
+	int error;
+	uint32_t log_part, n_pm;
+	uint8_t *pmap_pos;
+
+	n_pm = le32toh(ump->logical_vol->n_pm);
+	pmap_pos = ump->logical_vol->maps;
+	for (log_part = 0; log_part < n_pm; log_part++) {
+		mapping = (union udf_pmap *)pmap_pos;
+		if (ump->vtop_tp[log_part] == UDF_VTOP_TYPE_SPARABLE) {
+			error = udf_read_sparables(ump, mapping);
+			if (error != 0)
+				return (error);
+		}
+		pmap_pos += pmap_pos[1];
+	}
+
+	return (0);
+}
+
+/* lock held */
+static int
+udf_check_snapshot_sparing(struct udf_mount *ump, struct udf_snapshot *snap)
+{
+	uint32_t size;
+
+	if (ump->sparing_table == NULL && snap->sparing_table == NULL)
+		return (0);
+	if (ump->sparing_table == NULL || snap->sparing_table == NULL)
+		return (ENOENT);
+
+	size = udf_tagsize((union dscrptr *)ump->sparing_table,
+	    ump->sector_size);
+	if (size != udf_tagsize((union dscrptr *)snap->sparing_table,
+	    ump->sector_size) ||
+	    memcmp(ump->sparing_table, snap->sparing_table, size) != 0)
+		return (ENOENT);
+
+	return (0);
+}
+
+/*
+ * Called once the anchors, VDS and integrity sequence have been read:
+ * record what identifies the volume and, if a snapshot of it is kept and
+ * its sparing table still matches, take the VAT from it.  The key holds
+ * the anchor and the tag of the integrity descriptor, whose CRC covers
+ * the descriptor as read.  Returns ENOENT when the tables still have to
+ * be read from disc; the fileset and root directory always are.
+ */
+int
+udf_restore_snapshot(struct udf_mount *ump)
+{
+	struct udf_volkey *key = &ump->volkey;
+	struct udf_snapshot *snap;
+	long memused;
+	uint32_t n_pm;
+	int found, i;
+
+	memset(key, 0, sizeof(*key));
+	memcpy(key->volset_id, ump->primary_vol->volset_id,
+	    sizeof(key->volset_id));
+	memcpy(key->logvol_id, ump->logical_vol->logvol_id,
+	    sizeof(key->logvol_id));
+	key->lvid_time = ump->logvol_integrity->time;
+	key->next_unique_id =
+	    le64toh(ump->logvol_integrity->lvint_next_unique_id);
+	key->session_start = ump->session_start;
+	key->last_written = ump->session_last_written;
+	for (i = 0; i < UDF_ANCHORS; i++) {
+		if (ump->anchors[i] != NULL) {
+			key->anchor = *ump->anchors[i];
+			break;
+		}
+	}
+	key->lvid_tag = ump->logvol_integrity->tag;
+
+	if (udf_snapshots_max == 0)
+		return (ENOENT);
+
+	sx_slock(&udf_snapshot_lock);
+	found = udf_find_snapshot(key) != NULL;
+	sx_sunlock(&udf_snapshot_lock);
+	if (!found || udf_read_snapshot_sparing(ump) != 0)
+		return (ENOENT);
+
+	/* it may have been dropped while the sparing table was read */
+	sx_xlock(&udf_snapshot_lock);
+	snap = udf_find_snapshot(key);
+	if (snap == NULL || udf_check_snapshot_sparing(ump, snap) != 0) {
+		sx_xunlock(&udf_snapshot_lock);
+		return (ENOENT);
+	}
+	TAILQ_REMOVE(&udf_snapshots, snap, link);
+	TAILQ_INSERT_HEAD(&udf_snapshots, snap, link);
+
+	free(ump->logical_vol, M_UDFTEMP);
+	ump->logical_vol = udf_dup_dscr(snap->logical_vol, ump->sector_size,
+	    NULL);
+	free(ump->logvol_integrity, M_UDFTEMP);
+	ump->logvol_integrity = udf_dup_dscr(snap->logvol_integrity,
+	    ump->sector_size, NULL);
+
+	ump->vat_entries = snap->vat_entries;
+	ump->vat_offset = snap->vat_offset;
+	ump->vat_npages = snap->vat_npages;
+	memused = 0;
+	ump->vat_pages = udf_dup_vat(snap->vat_pages, snap->vat_npages,
+	    &memused);
+	udf_account_vat(ump, memused);
+	sx_xunlock(&udf_snapshot_lock);
+
+	/* logvol_info points into the integrity descriptor */
+	n_pm = le32toh(ump->logical_vol->n_pm);
+	ump->logvol_info = (struct udf_logvol_info *)
+	    (&ump->logvol_integrity->tables[2 * n_pm]);
+	udf_update_logvolname(ump, ump->logical_vol->logvol_id);
+
+	return (0);
+}
+
+/* keep the tables of a volume that mounted fine for its next mount */
+void
+udf_save_snapshot(struct udf_mount *ump)
+{
+	struct udf_snapshot *old, *snap;
+	uint32_t log_part, n_pm;
+
+	if (udf_snapshots_max == 0) {
+		/* turned off, let go of what is kept */
+		udf_free_snapshots();
+		return;
+	}
+
+	/* a VAT read in on demand is not all there */
+	if (ump->vat_node != NULL)
+		return;
+
+	n_pm = le32toh(ump->logical_vol->n_pm);
+	for (log_part = 0; log_part < n_pm; log_part++)
+		if (ump->vtop_tp[log_part] == UDF_VTOP_TYPE_META)
+			return;
+
+	snap = malloc(sizeof(struct udf_snapshot), M_UDFTEMP,
+	    M_WAITOK | M_ZERO);
+	snap->key = ump->volkey;
+	snap->memused = sizeof(struct udf_snapshot);
+	snap->logical_vol = udf_dup_dscr(ump->logical_vol, ump->sector_size,
+	    &snap->memused);
+	snap->logvol_integrity = udf_dup_dscr(ump->logvol_integrity,
+	    ump->sector_size, &snap->memused);
+	snap->sparing_table = udf_dup_dscr(ump->sparing_table,
+	    ump->sector_size, &snap->memused);
+	snap->vat_entries = ump->vat_entries;
+	snap->vat_offset = ump->vat_offset;
+	snap->vat_npages = ump->vat_npages;
+	snap->vat_pages = udf_dup_vat(ump->vat_pages, ump->vat_npages,
+	    &snap->memused);
+
+	if (snap->memused > udf_snapshot_maxmem) {
+		udf_free_snapshot(snap);
+		return;
+	}
+
+	sx_xlock(&udf_snapshot_lock);
+	old = udf_find_snapshot(&snap->key);
+	if (old != NULL) {
+		TAILQ_REMOVE(&udf_snapshots, old, link);
+		udf_nsnapshots--;
+		atomic_add_long(&udf_snapshot_mem, -old->memused);
+		udf_free_snapshot(old);
+	}
+	TAILQ_INSERT_HEAD(&udf_snapshots, snap, link);
+	udf_nsnapshots++;
+	atomic_add_long(&udf_snapshot_mem, snap->memused);
+	udf_trim_snapshots(udf_snapshots_max, udf_snapshot_maxmem);
+	sx_xunlock(&udf_snapshot_lock);
+}
+
 /* 
  * To make absolutely sure we are NOT returning zero, add one.  This can fail,
  * but in final version should probably never fail.
@@ -1637,12 +2384,9 @@ udf_get_node(struct udf_mount *ump, struct long_ad icb_loc,
     struct udf_node **ppunode)
 {
 	union dscrptr *dscr;
-	struct long_ad last_fe_icb_loc;
 	struct udf_node *udf_node;
-	uint64_t file_size;
-	int dscr_type, eof, error, slot, strat, strat4096;
-	uint32_t dummy, lb_size, sector;
-	uint8_t  *file_data;
+	int dscr_type, error, strat, strat4096;
+	uint32_t dummy, sector;
 
 	/* garbage check: translate udf_node_icb_loc to sectornr */
 	error = udf_translate_vtop(ump, &icb_loc, &sector, &dummy);
@@ -1660,9 +2404,6 @@ udf_get_node(struct udf_mount *ump, struct long_ad icb_loc,
 /*	mutex_exit(&ump->get_node_lock); */
 
 	strat4096 = 0;
-	file_size = 0;
-	file_data = NULL;
-	lb_size = le32toh(ump->logical_vol->lb_size);
 
 	do {
 		/* try to read in fe/efe */
@@ -1697,25 +2438,17 @@ udf_get_node(struct udf_mount *ump, struct long_ad icb_loc,
 			break;
 		}
 
-		/* choose this one */
-		last_fe_icb_loc = icb_loc;
-		
 		/* record and process/update (ext)fentry */
-		file_data = NULL;
 		if (dscr_type == TAGID_FENTRY) {
 			if (udf_node->fe != NULL)
 				free(udf_node->fe, M_UDFTEMP);
 			udf_node->fe = &dscr->fe;
 			strat = le16toh(udf_node->fe->icbtag.strat_type);
-			file_size = le64toh(udf_node->fe->inf_len);
-			file_data = udf_node->fe->data;
 		} else {
 			if (udf_node->efe != NULL)
 				free(udf_node->efe, M_UDFTEMP);
 			udf_node->efe = &dscr->efe;
 			strat = le16toh(udf_node->efe->icbtag.strat_type);
-			file_size = le64toh(udf_node->efe->inf_len);
-			file_data = udf_node->efe->data;
 		}
 
 		/* check recording strategy (structure) */
@@ -1754,55 +2487,15 @@ udf_get_node(struct udf_mount *ump, struct long_ad icb_loc,
 	/*
 	 * Go trough all allocations extents of this descriptor and when
 	 * encountering a redirect read in the allocation extension. These are
-	 * daisy-chained.
+	 * daisy-chained and are flattened into one array of allocation
+	 * descriptors.
 	 */
 	UDF_LOCK_NODE(udf_node, 0);
-	udf_node->num_extensions = 0;
-
-	error = 0;
-	slot = 0;
-	for (;;) {
-		udf_get_adslot(udf_node, slot, &icb_loc, &eof);
-		if (eof != 0)
-			break;
-		slot++;
-
-		if (UDF_EXT_FLAGS(le32toh(icb_loc.len)) != UDF_EXT_REDIRECT)
-			continue;
-
-		if (udf_node->num_extensions >= UDF_MAX_ALLOC_EXTENTS) {
-			error = EINVAL;
-			break;
-		}
-
-		/* length can only be *one* lb : UDF 2.50/2.3.7.1 */
-		if (UDF_EXT_LEN(le32toh(icb_loc.len)) != lb_size) {
-			error = EINVAL;
-			break;
-		}
-
-		/* load in allocation extent */
-		error = udf_translate_vtop(ump, &icb_loc, &sector, &dummy);
-		if (error == 0)
-			error = udf_read_phys_dscr(ump, sector, M_UDFTEMP, 
-			    &dscr);
-		if (error != 0 || dscr == NULL)
-			break;
-
-		/* process read-in descriptor */
-		dscr_type = le16toh(dscr->tag.id);
+	error = udf_read_adslots(udf_node);
 
-		if (dscr_type != TAGID_ALLOCEXTENT) {
-			free(dscr, M_UDFTEMP);
-			error = ENOENT;
-			break;
-		}
-
-		udf_node->ext[udf_node->num_extensions] = &dscr->aee;
-
-		udf_node->num_extensions++;
-
-	} /* while */
+	/* decode the allocation descriptors into the extent map */
+	if (error == 0)
+		error = udf_build_extent_map(udf_node);
 	UDF_UNLOCK_NODE(udf_node, 0);
 
 	/* second round of cleanup code */
@@ -1822,7 +2515,6 @@ udf_get_node(struct udf_mount *ump, struct long_ad icb_loc,
 int
 udf_dispose_node(struct udf_node *udf_node)
 {
-	int extnr;
 
 	if (udf_node == NULL)
 		return (0);
@@ -1830,10 +2522,11 @@ udf_dispose_node(struct udf_node *udf_node)
 	/* TODO extended attributes and streamdir */
 
 	/* free associated memory and the node itself */
-	for (extnr = 0; extnr < udf_node->num_extensions; extnr++) {
-		free(udf_node->ext[extnr], M_UDFTEMP);
-		udf_node->ext[extnr] = (void *)0xdeadcccc;
-	}
+	if (udf_node->adslots != NULL)
+		free(udf_node->adslots, M_UDFTEMP);
+
+	if (udf_node->extents != NULL)
+		free(udf_node->extents, M_UDFTEMP);
 
 	if (udf_node->fe != NULL)
 		free(udf_node->fe, M_UDFTEMP);
@@ -1887,43 +2580,98 @@ brokendir:
 }
 
 /*
- * Read and write file extent in/from the buffer.
- *
- * The splitup of the extent into seperate request-buffers is to minimise
- * copying around as much as possible.
- *
- * block based file reading and writing
+ * Directory streams are read in chunks of up to MAXBSIZE and the FIDs are
+ * handed out in place.  A FID is never split: when less than a sector is
+ * left in the chunk, the chunk is refilled starting at that FID.
  */
 
-int
-udf_read_internal(struct udf_node *node, uint8_t *blob)
+void
+udf_dirstream_init(struct udf_dirstream *ds, struct vnode *vp,
+    uint64_t offset)
 {
-	struct file_entry *fe = node->fe;
-	struct extfile_entry *efe = node->efe;
-	struct udf_mount *ump;
-	uint64_t inflen;
-	int addr_type, icbflags;
+	struct udf_node *dir_node = VTOI(vp);
+	uint64_t len;
 	uint32_t sector_size;
-	uint8_t *pos;
+	uint8_t *data;
 
-	/* get extent and do some paranoia checks */
-	ump = node->ump;
-	sector_size = ump->sector_size;
+	sector_size = dir_node->ump->sector_size;
 
-	if (fe != NULL) {
-		inflen = le64toh(fe->inf_len);
-		pos = &fe->data[0] + le32toh(fe->l_ea);
-		icbflags = le16toh(fe->icbtag.flags);
-	} else {
-		inflen = le64toh(efe->inf_len);
-		pos = &efe->data[0] + le32toh(efe->l_ea);
-		icbflags = le16toh(efe->icbtag.flags);
+	ds->vp = vp;
+	if (dir_node->fe != NULL)
+		ds->file_size = le64toh(dir_node->fe->inf_len);
+	else
+		ds->file_size = le64toh(dir_node->efe->inf_len);
+	ds->offset = offset;
+	ds->buf_off = 0;
+	ds->buf_len = 0;
+
+	/* an embedded directory is scanned in place and never refilled */
+	if (udf_intern_data(dir_node, &data, &len) == 0 && data != NULL) {
+		ds->buf = data;
+		ds->buf_len = len;
+		ds->buf_size = 0;
+		return;
+	}
+
+	ds->buf_size = MIN(roundup(ds->file_size, sector_size), MAXBSIZE);
+	ds->buf_size = MAX(ds->buf_size, sector_size);
+	ds->buf = malloc(ds->buf_size, M_UDFTEMP, M_WAITOK);
+}
+
+/*
+ * Return the next FID of the stream in (*fidp), or NULL at the end of the
+ * directory.  The FID stays valid until the next call.
+ */
+int
+udf_dirstream_next(struct udf_dirstream *ds, struct fileid_desc **fidp)
+{
+	struct fileid_desc *fid;
+	uint64_t buf_end;
+	uint32_t avail, sector_size;
+	int error, size;
+
+	*fidp = NULL;
+	if (ds->offset >= ds->file_size)
+		return (0);
+
+	sector_size = VTOI(ds->vp)->ump->sector_size;
+	buf_end = ds->buf_off + ds->buf_len;
+	if (ds->offset < ds->buf_off || ds->offset >= buf_end ||
+	    (buf_end - ds->offset < sector_size && buf_end < ds->file_size)) {
+		ds->buf_off = ds->offset;
+		ds->buf_len = MIN(ds->file_size - ds->offset, ds->buf_size);
+		error = vn_rdwr(UIO_READ, ds->vp, ds->buf, ds->buf_len,
+		    ds->buf_off, UIO_SYSSPACE, IO_NODELOCKED, FSCRED, NULL,
+		    NULL, curthread);
+		if (error != 0) {
+			ds->buf_len = 0;
+			return (error);
+		}
 	}
-	addr_type = icbflags & UDF_ICB_TAG_FLAGS_ALLOC_MASK;
 
-	/* copy out info */
-	memset(blob, 0, sector_size);
-	memcpy(blob, pos, inflen);
+	avail = ds->buf_off + ds->buf_len - ds->offset;
+	if (avail < UDF_FID_SIZE)
+		return (EIO);
+
+	fid = (struct fileid_desc *)(ds->buf + (ds->offset - ds->buf_off));
+	size = MIN(avail, sector_size);
+	error = udf_validate_fid(fid, &size);
+	if (error != 0)
+		return (error);
+	if (size > avail)
+		return (EIO);
+
+	ds->offset += size;
+	*fidp = fid;
 
 	return (0);
 }
+
+void
+udf_dirstream_done(struct udf_dirstream *ds)
+{
+
+	if (ds->buf_size != 0)
+		free(ds->buf, M_UDFTEMP);
+	ds->buf = NULL;
+}
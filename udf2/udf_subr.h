@@ -45,13 +45,26 @@ int	udf_tagsize(union dscrptr *dscr, uint32_t udf_sector_size);
 /* read/write descriptors */
 int	udf_read_phys_dscr(struct udf_mount *ump, uint32_t sector,
 	    struct malloc_type *mtype, union dscrptr **dstp);
+void	udf_read_phys_dscrs(struct udf_mount *ump, int n, uint32_t *sectors,
+	    struct malloc_type *mtype, union dscrptr **dstp, int *errors);
+int	udf_prefetch_dscrs(struct udf_mount *ump, uint32_t start,
+	    uint32_t sectors);
+int	udf_prefetch_dscrs2(struct udf_mount *ump, uint32_t start,
+	    uint32_t sectors, uint32_t alt_start, uint32_t alt_sectors);
+void	udf_switch_dscrs(struct udf_mount *ump);
+void	udf_release_dscrs(struct udf_mount *ump);
+int	udf_is_blank(void *sector, int sector_size);
 
 /* volume descriptors readers and checkers */
 int	udf_read_anchors(struct udf_mount *ump);
 int	udf_read_vds_space(struct udf_mount *ump);
 int	udf_process_vds(struct udf_mount *ump);
 int	udf_read_vds_tables(struct udf_mount *ump);
+void	udf_build_sparing_map(struct udf_mount *ump);
 int	udf_read_rootdirs(struct udf_mount *ump);
+int	udf_restore_snapshot(struct udf_mount *ump);
+void	udf_save_snapshot(struct udf_mount *ump);
+void	udf_free_snapshots(void);
 
 /* open/close and sync volumes */
 int	udf_open_logvol(struct udf_mount *ump);
@@ -62,13 +75,18 @@ int	udf_translate_vtop(struct udf_mount *ump, struct long_ad *icb_loc,
 	    uint32_t *lb_numres, uint32_t *extres);
 int	udf_bmap_translate(struct udf_node *udf_node, uint32_t block, 
 	    int *exttype, uint64_t *lsector, uint32_t *maxblks);
+int	udf_read_adslots(struct udf_node *udf_node);
+int	udf_build_extent_map(struct udf_node *udf_node);
+struct udf_extent *udf_find_extent(struct udf_node *udf_node,
+	    uint64_t foffset);
 void	udf_get_adslot(struct udf_node *udf_node, int slot, struct long_ad *icb,
 	    int *eof);
 int	udf_append_adslot(struct udf_node *udf_node, int *slot,
 	    struct long_ad *icb);
 
-int	udf_vat_read(struct udf_mount *ump, uint8_t *blob, int size,
-	    uint32_t offset);
+int	udf_lookup_vat(struct udf_mount *ump, uint32_t lb_num,
+	    uint32_t *entry);
+void	udf_free_vat(struct udf_mount *ump);
 
 /* disc allocation */
 int	udf_get_c_type(struct udf_node *udf_node);
@@ -97,8 +115,16 @@ void	udf_read_filebuf(struct udf_node *node, struct buf *buf);
 /* directory operations and helpers */
 void	udf_osta_charset(struct charspec *charspec);
 int	udf_validate_fid(struct fileid_desc *fid, int *realsize);
+void	udf_dirstream_init(struct udf_dirstream *ds, struct vnode *vp,
+	    uint64_t offset);
+int	udf_dirstream_next(struct udf_dirstream *ds,
+	    struct fileid_desc **fidp);
+void	udf_dirstream_done(struct udf_dirstream *ds);
 int	udf_lookup_name_in_dir(struct vnode *vp, const char *name, int namelen,
 	    struct long_ad *icb_loc, int *found);
+int	udf_dirhash_lookup(struct vnode *dvp, const char *name, int namelen,
+	    int isdotdot, ino_t *id, uint64_t *diroff);
+void	udf_dirhash_free(struct udf_node *udf_node);
 
 /* helpers and converters */
 int	udf_get_node_id(const struct long_ad icbptr, ino_t *ino);
@@ -106,12 +132,12 @@ void	udf_get_node_longad(const ino_t ino, struct long_ad *icbptr);
 uint32_t udf_getaccessmode(struct udf_node *node);
 void	udf_to_unix_name(struct udf_mount *ump, char *result, int result_len,
 	    uint8_t *id, int len);
+void	udf_iconv_table(struct udf_mount *ump);
 void	udf_timestamp_to_timespec(struct udf_mount *ump,
 	    struct timestamp *timestamp, struct timespec *timespec);
 
 /* vnode operations */
 int	udf_getanode(struct mount *mp, struct vnode **vpp);
-int	udf_read_internal(struct udf_node *node, uint8_t *blob);
 
 /* Created by for testing */
 struct	udf_node * udf_alloc_node(void);
@@ -119,4 +145,10 @@ void	udf_free_node(struct udf_node *unode);
 int	udf_vget(struct mount *mp, ino_t ino, int flags, struct vnode **vpp);
 int	udf_read_node(struct udf_node *unode, uint8_t *blob, off_t start,
 	    int length);
+int	udf_read_node_direct(struct udf_node *unode, uint8_t *blob,
+	    off_t start, int length);
+void	udf_read_node_async(struct udf_node *unode, uint8_t *blob,
+	    off_t start, int length, void (*done)(void *, int), void *arg);
+int	udf_intern_data(struct udf_node *unode, uint8_t **data,
+	    uint64_t *len);
 #endif	/* !_FS_UDF_UDF_SUBR_H_ */
@@ -41,6 +41,7 @@
 #include <sys/priv.h>
 #include <sys/iconv.h>
 #include <sys/stat.h>
+#include <sys/sysctl.h>
 #if 0
 #include <sys/udfio.h>
 #endif
@@ -56,6 +57,8 @@ uma_zone_t udf_zone_node = NULL;
 
 struct iconv_functions *udf2_iconv = NULL;
 
+SYSCTL_NODE(_vfs, OID_AUTO, udf2, CTLFLAG_RW, 0, "UDF file system");
+
 static int	udf_mountfs(struct vnode *, struct mount *); 
 
 
@@ -102,6 +105,8 @@ udf_init(struct vfsconf *notused)
 static int
 udf_uninit(struct vfsconf *notused)
 {
+	udf_free_snapshots();
+
 	/* remove pools */
 	if (udf_zone_node != NULL) {
 		uma_zdestroy(udf_zone_node);
@@ -127,6 +132,8 @@ free_udf_mountinfo(struct mount *mp)
 		/* Metadata partition support */
 		if (ump->metadata_node != NULL)
 			udf_dispose_node(ump->metadata_node);
+		if (ump->metadata_mirror_node != NULL)
+			udf_dispose_node(ump->metadata_mirror_node);
 
 		/* clear our data */
 		for (i = 0; i < UDF_ANCHORS; i++)
@@ -141,7 +148,11 @@ free_udf_mountinfo(struct mount *mp)
 		}
 		MPFREE(ump->fileset_desc, M_UDFTEMP);
 		MPFREE(ump->sparing_table, M_UDFTEMP);
-		MPFREE(ump->vat_table, M_UDFTEMP);
+		MPFREE(ump->sparing_map, M_UDFTEMP);
+		udf_free_vat(ump);
+		MPFREE(ump->dscr_win, M_UDFTEMP);
+		MPFREE(ump->dscr_alt, M_UDFTEMP);
+		MPFREE(ump->iconv_tbl, M_UDFTEMP);
 
 		free(ump, M_UDFTEMP);
 	}
@@ -301,7 +312,7 @@ udf_mountfs(struct vnode *devvp, struct mount *mp)
 #if 0
 	struct udf_session_info usi;
 #endif
-	int error, len, num_anchors;
+	int error, len, num_anchors, snapshot;
 	uint32_t bshift, logvol_integrity, numsecs; /*lb_size,*/
 	char *cs_local;
 	void *optdata = NULL;
@@ -391,6 +402,16 @@ udf_mountfs(struct vnode *devvp, struct mount *mp)
 		ump->flags |= UDFMNT_USE_DIRMASK;
 	}
 
+	/* read-ahead limit in bytes; by default only the sysctl limits it */
+	ump->readahead = UINT32_MAX;
+	if (vfs_getopt(mp->mnt_optnew, "readahead", &optdata, &len) == 0) {
+		if (len != sizeof(uint32_t)) {
+			error = EINVAL;
+			goto fail;
+		}
+		ump->readahead = *(uint32_t *)optdata;
+	}
+
 #if 0
 	printf("si_name: %s\n", devvp->v_rdev->si_name);
 	if (devvp->v_rdev->si_name[0] == 'c' && 
@@ -447,13 +468,8 @@ udf_mountfs(struct vnode *devvp, struct mount *mp)
 	numsecs = cp->provider->mediasize / cp->provider->sectorsize;
 	if (ump->session_end == 0)
 		ump->session_end = numsecs;
-	
-	/* We should only need to search one, so this is also a hack. */
-	if (ump->session_end - ump->session_start > 25)
-		ump->first_possible_vat_location = ump->session_last_written -
-		    25; 
-	else
-		ump->first_possible_vat_location = ump->session_start;
+
+	/* udf_search_vat() looks back from here */
 	ump->last_possible_vat_location = ump->session_last_written;
 
 	error = vfs_getopt(mp->mnt_optnew, "cs_local", (void **)&cs_local,
@@ -467,6 +483,8 @@ udf_mountfs(struct vnode *devvp, struct mount *mp)
 		}
 
 		udf2_iconv->open(cs_local, "UTF-16BE", &ump->iconv_d2l);
+		if (ump->iconv_d2l != NULL)
+			udf_iconv_table(ump);
 	}
 
 	/* inspect sector size */
@@ -487,6 +505,13 @@ udf_mountfs(struct vnode *devvp, struct mount *mp)
 		return (EIO);
 	}
 
+	/*
+	 * file data is cached in blocks of several sectors; blocks that do
+	 * not map onto a single run of sectors are assembled by udf_strategy()
+	 */
+	ump->bsize = MAXBSIZE;
+	mp->mnt_stat.f_iosize = ump->bsize;
+
 
 	/* read all anchors to get volume descriptor sequence */
 	num_anchors = udf_read_anchors(ump);
@@ -510,13 +535,18 @@ udf_mountfs(struct vnode *devvp, struct mount *mp)
 		goto fail;
 	}
 
+	/* an unchanged volume that was mounted before needs no more reads */
+	snapshot = udf_restore_snapshot(ump) == 0;
+
 	/* note that the mp info needs to be initialised for reading! */
 	/* read vds support tables like VAT, sparable etc. */
-	error = udf_read_vds_tables(ump);
-	if (error != 0) {
-		printf("UDF mount: error in format or damaged disc "
-		    "(VDS tables failing)\n");
-		goto fail;
+	if (!snapshot) {
+		error = udf_read_vds_tables(ump);
+		if (error != 0) {
+			printf("UDF mount: error in format or damaged disc "
+			    "(VDS tables failing)\n");
+			goto fail;
+		}
 	}
 
 	/* check if volume integrity is closed otherwise its dirty */
@@ -532,10 +562,12 @@ udf_mountfs(struct vnode *devvp, struct mount *mp)
 	/* read root directory */
 	error = udf_read_rootdirs(ump);
 	if (error != 0) {
-		printf("UDF mount: disc not properly formatted or damaged disc "
-		    "(rootdirs failing)\n");
+		printf("UDF mount: disc not properly formatted or "
+		    "damaged disc (rootdirs failing)\n");
 		goto fail;
 	}
+	if (!snapshot)
+		udf_save_snapshot(ump);
 
 	/* success! */
 	return (0);
@@ -597,7 +629,7 @@ udf_statfs(struct mount *mp, struct statfs *sbp)
 	/*uint32_t f_type;*/			/* type of filesystem */
 	sbp->f_flags = mp->mnt_flag; 		/* copy of mount exported flags */
 	sbp->f_bsize = ump->sector_size; 	/* filesystem fragment size */
-	sbp->f_iosize = ump->sector_size; 	/* optimal transfer block size */
+	sbp->f_iosize = ump->bsize;		/* optimal transfer block size */
 	sbp->f_blocks = sizeblks;		/* total data blocks in filesystem */
 	sbp->f_bfree  = freeblks;		/* free blocks in filesystem */
 	sbp->f_bavail = 0;			/* free blocks avail to non-superuser */
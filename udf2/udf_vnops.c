@@ -43,6 +43,7 @@
 #include <sys/bio.h>
 #include <sys/stat.h>
 #include <sys/rwlock.h>
+#include <sys/sysctl.h>
 
 #include <vm/vm.h>
 #include <vm/vm_page.h>
@@ -59,6 +60,12 @@
 
 static int udf_pbuf_freecnt = -1;
 
+SYSCTL_DECL(_vfs_udf2);
+
+static u_int udf_readahead_max = IO_SEQMAX * MAXBSIZE;
+SYSCTL_UINT(_vfs_udf2, OID_AUTO, readahead_max, CTLFLAG_RW,
+    &udf_readahead_max, 0, "maximum read-ahead of sequential reads in bytes");
+
 static vop_access_t	udf_access;
 static vop_bmap_t       udf_bmap;
 static vop_cachedlookup_t udf_cachedlookup;
@@ -129,12 +136,61 @@ udf_reclaim(struct vop_reclaim_args *ap)
 
 	/* dispose all node knowledge */
 	vfs_hash_remove(vp);
+	udf_dirhash_free(udf_node);
 	udf_dispose_node(udf_node);
 	vp->v_data = NULL;
 
 	return (0);
 }
 
+/*
+ * Work out how far to read ahead, in blocks for cluster_read().  Reads
+ * that continue where the previous one ended double the window; anything
+ * else resets it.  The read-ahead, from the window or from the caller's
+ * sequential hint, is capped by the readahead mount option and
+ * vfs.udf2.readahead_max, so 0 turns it off.  As the run returned by
+ * udf_bmap() ends with the extent, clusters never span extents.  Reads may
+ * run with the vnode shared locked, so updates can race; that only costs
+ * a wrong guess.
+ */
+static int
+udf_read_seqcount(struct udf_node *udf_node, struct uio *uio, int ioflag)
+{
+	struct udf_mount *ump = udf_node->ump;
+	uint32_t maxra, window;
+	int seqcount;
+
+	maxra = min(ump->readahead, udf_readahead_max);
+	maxra = min(maxra, IO_SEQMAX * ump->bsize);
+
+	window = udf_node->ra_window;
+	if (uio->uio_offset == udf_node->ra_nextoff)
+		window = min(MAX(window * 2, MIN(uio->uio_resid, maxra)),
+		    maxra);
+	else
+		window = 0;
+	udf_node->ra_window = window;
+
+	seqcount = ioflag >> IO_SEQSHIFT;
+	if (window != 0)
+		seqcount = max(seqcount, howmany(window, ump->bsize));
+
+	return (min(seqcount, howmany(maxra, ump->bsize)));
+}
+
+/* size of block lbn; the last block of a file is cut to whole sectors */
+static int
+udf_blksize(struct udf_node *udf_node, uint64_t fsize, daddr_t lbn)
+{
+	struct udf_mount *ump = udf_node->ump;
+	uint64_t rest;
+
+	rest = fsize - (uint64_t)lbn * ump->bsize;
+	if (rest >= ump->bsize)
+		return (ump->bsize);
+	return (roundup2(rest, ump->sector_size));
+}
+
 static int
 udf_read(struct vop_read_args *ap)
 {
@@ -143,9 +199,9 @@ udf_read(struct vop_read_args *ap)
 	struct buf *bp;
 	struct udf_node *udf_node = VTOI(vp);
 	uint64_t fsize;
-	int seqcount, lbn, n, on, sector_size; 
+	int bsize, seqcount, lbn, n, on;
 	int error = 0;
-	uint8_t *zerobuf;
+	uint8_t *data, *zerobuf;
 
 	/* can this happen? some filingsystems have this check */
 	if (uio->uio_offset < 0)
@@ -159,43 +215,56 @@ udf_read(struct vop_read_args *ap)
 		panic("udf_read: type %d",  vp->v_type);
 #endif
 
-	/* get file/directory filesize */
-	if (udf_node->fe != NULL)
-		fsize = le64toh(udf_node->fe->inf_len);
-	else 
-		fsize = le64toh(udf_node->efe->inf_len);
+	/* get file/directory filesize and any data embedded in the entry */
+	error = udf_intern_data(udf_node, &data, &fsize);
+	if (error != 0)
+		return (error);
+
+	bsize = udf_node->ump->bsize;
 
-	sector_size = udf_node->ump->sector_size;
+	seqcount = udf_read_seqcount(udf_node, uio, ap->a_ioflag);
 
-	seqcount = ap->a_ioflag >> IO_SEQSHIFT;
+	/* embedded data is copied straight out, no buffers needed */
+	if (data != NULL && fsize > uio->uio_offset) {
+		n = min(fsize - uio->uio_offset, uio->uio_resid);
+		error = uiomove(data + uio->uio_offset, n, uio);
+	}
 
-	while (error == 0 && uio->uio_resid > 0 && fsize > uio->uio_offset) {
- 		lbn = uio->uio_offset / sector_size;
-		on = uio->uio_offset % sector_size;
+	while (data == NULL && error == 0 && uio->uio_resid > 0 &&
+	    fsize > uio->uio_offset) {
+ 		lbn = uio->uio_offset / bsize;
+		on = uio->uio_offset % bsize;
 
-		n = min(sector_size - on, uio->uio_resid);
-		n = min(n, fsize - uio->uio_offset);
+		n = min(bsize - on, uio->uio_resid);
+		if (n > fsize - uio->uio_offset)
+			n = fsize - uio->uio_offset;
 
-		if ((vp->v_mount->mnt_flag & MNT_NOCLUSTERR) == 0 &&
-		    sector_size * (lbn + 1) < fsize) {
+		if ((uint64_t)bsize * (lbn + 1) >= fsize) {
+			/* the last block only covers the end of the file */
+			error = bread(vp, lbn, udf_blksize(udf_node, fsize,
+			    lbn), NOCRED, &bp);
+		} else if ((vp->v_mount->mnt_flag & MNT_NOCLUSTERR) == 0) {
 #if __FreeBSD__ < 10
-			error = cluster_read(vp, fsize, lbn, sector_size, 
+			error = cluster_read(vp, fsize, lbn, bsize, 
 			    NOCRED, on + uio->uio_resid, seqcount, &bp);
 #else
-			error = cluster_read(vp, fsize, lbn, sector_size, 
+			error = cluster_read(vp, fsize, lbn, bsize, 
 			    NOCRED, on + uio->uio_resid, seqcount, 0, &bp);
 #endif
 		} else {
-			error = bread(vp, lbn, sector_size, NOCRED, &bp);
+			error = bread(vp, lbn, bsize, NOCRED, &bp);
+		}
+		if (error != 0) {
+			if (bp != NULL)
+				brelse(bp);
+			break;
 		}
 
-		n = min(n, sector_size - bp->b_resid);
-
-		if (error == 0) 
-			error = uiomove(bp->b_data + on, n, uio);
+		error = uiomove(bp->b_data + on, n, uio);
 
 		brelse(bp);
 	}
+	udf_node->ra_nextoff = uio->uio_offset;
 
 	if (vp->v_type == VDIR && fsize <= uio->uio_offset &&
 	    uio->uio_resid > 0) {
@@ -222,9 +291,10 @@ udf_bmap(struct vop_bmap_args /* {
 {
 	struct vnode *vp = ap->a_vp;
 	struct udf_node *udf_node = VTOI(vp);
+	struct udf_mount *ump = udf_node->ump;
 	uint64_t lsector;
 	int error, exttype;
-	uint32_t maxblks;
+	uint32_t maxblks, spb;
 
 	if (ap->a_bop != NULL)
 		*ap->a_bop = &ap->a_vp->v_bufobj;
@@ -233,18 +303,24 @@ udf_bmap(struct vop_bmap_args /* {
 		return (0);
 
 	/* get logical block and run */
-	error = udf_bmap_translate(udf_node, ap->a_bn, &exttype, &lsector,
-	    &maxblks);
+	spb = ump->bsize / ump->sector_size;
+	error = udf_bmap_translate(udf_node, ap->a_bn * spb, &exttype,
+	    &lsector, &maxblks);
 	if (error != 0)
 		return (error);
 
-	/* convert to dev blocks */
-	if (exttype == UDF_TRAN_INTERN)
-		*ap->a_bnp = INT64_MAX - 2;
-	else if (exttype == UDF_TRAN_ZERO)
-		*ap->a_bnp = INT64_MAX - 1; /* zero the buffer */
-	else
-		*ap->a_bnp = lsector * (udf_node->ump->sector_size/DEV_BSIZE);
+	/*
+	 * Only whole blocks inside one recorded extent map onto the device;
+	 * everything else is reported as a hole and filled in by
+	 * udf_strategy().
+	 */
+	if (exttype == UDF_TRAN_EXTERNAL && maxblks >= spb) {
+		*ap->a_bnp = lsector * (ump->sector_size / DEV_BSIZE);
+		maxblks /= spb;
+	} else {
+		*ap->a_bnp = -1;
+		maxblks = 1;
+	}
 
 	/* set runlength of maximum block size */
 	if (ap->a_runp != NULL)
@@ -257,65 +333,77 @@ udf_bmap(struct vop_bmap_args /* {
 	return (0);
 }
 
+/*
+ * Read a block that is not one run of sectors on the device: internal
+ * data, holes, blocks spanning extents and the partial last block.  The
+ * runs of the block are all read at once; a block holds whole sectors.
+ */
+static int
+udf_read_block(struct udf_node *udf_node, struct buf *bp)
+{
+	uint64_t fsize, offset;
+	int error, len;
+
+	if (udf_node->fe != NULL)
+		fsize = le64toh(udf_node->fe->inf_len);
+	else
+		fsize = le64toh(udf_node->efe->inf_len);
+
+	offset = (uint64_t)bp->b_lblkno * udf_node->ump->bsize;
+	len = 0;
+	if (offset < fsize)
+		len = MIN(bp->b_bcount, fsize - offset);
+
+	error = udf_read_node_direct(udf_node, (uint8_t *)bp->b_data, offset,
+	    len);
+	if (len < bp->b_bcount)
+		memset(bp->b_data + len, 0, bp->b_bcount - len);
+
+	return (error);
+}
+
 static int
 udf_strategy(struct vop_strategy_args *ap)
 {
 	struct vnode *vp = ap->a_vp;
 	struct buf *bp = ap->a_bp;
 	struct udf_node *udf_node = VTOI(vp);
-	struct bufobj *bo = &udf_node->ump->devvp->v_bufobj;
+	struct udf_mount *ump = udf_node->ump;
+	struct bufobj *bo = &ump->devvp->v_bufobj;
 	uint64_t lsector;
 	int error, exttype;
-	uint32_t sector_size, maxblks;
+	uint32_t maxblks;
 
 	if (vp->v_type == VBLK || vp->v_type == VCHR)
 		panic("udf_strategy: spec");
 
-	/* get sector size */
-	sector_size = udf_node->ump->sector_size;
-
+	if ((bp->b_iocmd & BIO_READ) == 0)
+		return (ENOTSUP);
 
 	/* get logical block and run */
 	if (bp->b_blkno == bp->b_lblkno) {
-		error = udf_bmap_translate(udf_node, bp->b_lblkno, &exttype,
+		error = udf_bmap_translate(udf_node,
+		    bp->b_lblkno * (ump->bsize / ump->sector_size), &exttype,
 		    &lsector, &maxblks);
-
-		if (error != 0) {
-			bp->b_error = error;
-			bp->b_ioflags |= BIO_ERROR;
+		if (error == 0 && exttype == UDF_TRAN_EXTERNAL &&
+		    (uint64_t)maxblks * ump->sector_size >= bp->b_bcount)
+			bp->b_blkno = lsector * (ump->sector_size / DEV_BSIZE);
+		else {
+			if (error == 0)
+				error = udf_read_block(udf_node, bp);
+			if (error != 0) {
+				bp->b_error = error;
+				bp->b_ioflags |= BIO_ERROR;
+			}
 			bufdone(bp);
-			return (error);
-		}
-
-		if (exttype == UDF_TRAN_ZERO) {
-			bp->b_blkno = INT64_MAX - 1;
-			vfs_bio_clrbuf(bp);
+			return (0);
 		}
-		else if (exttype == UDF_TRAN_INTERN)
-			bp->b_blkno = INT64_MAX - 2;
-		else
-			bp->b_blkno = lsector * (sector_size / DEV_BSIZE);
 	}
 
-	if ((bp->b_iocmd & BIO_READ) == 0)
-		return (ENOTSUP);
+	bp->b_iooffset = dbtob(bp->b_blkno);
+	BO_STRATEGY(bo, bp);
 
-	if (bp->b_blkno == INT64_MAX - 1) {
-		bufdone(bp);
-//printf("UDF: Hole in file found. (This is a debuging statement, not an error.\n");
-	} else if (bp->b_blkno == INT64_MAX - 2) {
-		error = udf_read_internal(udf_node, (uint8_t *)bp->b_data);
-		if (error != 0) {
-			bp->b_error = error;
-			bp->b_ioflags |= BIO_ERROR;
-		}
-		bufdone(bp);
-	} else {
-		bp->b_iooffset = dbtob(bp->b_blkno);
-		BO_STRATEGY(bo, bp);
-	}
-
-	return (bp->b_error);
+	return (0);
 }
 
 static int
@@ -325,13 +413,13 @@ udf_readdir(struct vop_readdir_args *ap)
 	struct vnode *vp;
 	struct fileid_desc *fid;
 	struct dirent *dirent;
+	struct udf_dirstream ds;
 	struct udf_mount *ump;
 	struct udf_node *udf_node;
 	uint64_t file_size;
 	u_long *cookies, *cookiesp;
 	off_t diroffset, transoffset;
-	int acookies, error, ncookies, size;
-	uint32_t lb_size;
+	int acookies, error, ncookies;
 	uint8_t *fid_name;
 	
 	error = 0;
@@ -391,36 +479,24 @@ udf_readdir(struct vop_readdir_args *ap)
 		}
 	}
 
-	/* allocate temporary space for fid */
-	lb_size = ump->sector_size;
-	fid = malloc(lb_size, M_UDFTEMP, M_WAITOK);
-
 	/* we are called just as long as we keep on pushing data in */
 	if (transoffset == 1)
 		diroffset = 0;
 	else
 		diroffset = transoffset;
 
-	while (diroffset < file_size) {
-		/* transfer a new fid/dirent */
-		memset(fid, 0, lb_size);
-		size = MIN(file_size - diroffset, lb_size);
-
-		error = vn_rdwr(UIO_READ, vp, fid, size, diroffset, 
-		    UIO_SYSSPACE, IO_NODELOCKED, FSCRED, NULL, NULL, 
-		    curthread);
+	udf_dirstream_init(&ds, vp, diroffset);
+	for (;;) {
+		/* get the next fid in the stream */
+		error = udf_dirstream_next(&ds, &fid);
 		if (error != 0) {
 			printf("UDF: Error reading fid: %d\n", error);
 			break;
 		}
-
-		error = udf_validate_fid(fid, &size);
-		if (error != 0) {
-			printf("UDF: Invalid fid found: %d\n", error);
+		if (fid == NULL)
 			break;
-		}
 
-		diroffset += size;
+		diroffset = ds.offset;
 		
 		/* skip deleted and not visible files */
 		if (fid->file_char & UDF_FILE_CHAR_DEL ||
@@ -482,7 +558,7 @@ udf_readdir(struct vop_readdir_args *ap)
 
 	/* pass on last transfered offset */
 	/* We lied for '.', so tell more lies. */
-	free(fid, M_UDFTEMP);
+	udf_dirstream_done(&ds);
 
 	uio->uio_offset = transoffset; 
 
@@ -511,18 +587,20 @@ udf_cachedlookup(struct vop_cachedlookup_args *ap)
 	struct vnode *tdp = NULL;
 	struct componentname *cnp = ap->a_cnp;
 	struct fileid_desc *fid;
+	struct udf_dirstream ds;
 	struct udf_node  *dir_node; 
 	struct udf_mount *ump;
 	uint64_t file_size, offset;
 	ino_t id = 0;
 	int error, islastcn, ltype, mounted_ro, nameiop, numpasses, unix_len;
-	int size;
 	uint8_t *fid_name;
 	char *unix_name;
 
 	dir_node = VTOI(dvp);
 	ump = dir_node->ump;
 	*vpp = NULL;
+	ds.buf = NULL;
+	unix_name = NULL;
 	error = 0;
 
 	/* simplify/clarification flags */
@@ -543,6 +621,16 @@ udf_cachedlookup(struct vop_cachedlookup_args *ap)
 	else
 		file_size = le64toh(dir_node->efe->inf_len);
 
+	/* large directories are served from their name index */
+	error = udf_dirhash_lookup(dvp, cnp->cn_nameptr, cnp->cn_namelen,
+	    cnp->cn_flags & ISDOTDOT, &id, &offset);
+	if (error == 0 || error == ENOENT) {
+		numpasses = 1;
+		error = 0;
+		goto found;
+	}
+	error = 0;
+
 	if (nameiop != LOOKUP || dir_node->diroff == 0 || 
 	    dir_node->diroff > file_size) {
 		offset = 0;
@@ -554,28 +642,20 @@ udf_cachedlookup(struct vop_cachedlookup_args *ap)
 		nchstats.ncs_2passes++;
 	}
 
-	fid = malloc(ump->sector_size, M_UDFTEMP, M_WAITOK);
+	udf_dirstream_init(&ds, dvp, offset);
 	unix_name = malloc(MAXNAMLEN, M_UDFTEMP, M_WAITOK);
 lookuploop:
-	while (offset < file_size) {
-		/* transfer a new fid/dirent */
-		memset(fid, 0, ump->sector_size);
-		size = MIN(file_size - offset, ump->sector_size);
-
-		error = vn_rdwr(UIO_READ, dvp, fid, size, offset, UIO_SYSSPACE,
-		    IO_NODELOCKED, FSCRED, NULL, NULL, curthread);
+	for (;;) {
+		/* get the next fid in the stream */
+		error = udf_dirstream_next(&ds, &fid);
 		if (error != 0) {
 			printf("UDF: Error reading fid: %d\n", error);
 			break;
 		}
-
-		error = udf_validate_fid(fid, &size);
-		if (error != 0) {
-			printf("UDF: Invalid fid found: %d\n", error);
+		if (fid == NULL)
 			break;
-		}
 
-		offset += size;
+		offset = ds.offset;
 
 		/* skip deleted entries */
 		if (fid->file_char & UDF_FILE_CHAR_DEL)
@@ -607,6 +687,7 @@ lookuploop:
 		}
 	}
 
+found:
 	if (error != 0)
 		goto exit; 
 
@@ -641,7 +722,7 @@ lookuploop:
 	}
 	else {
 		if (numpasses-- == 2) {
-			offset = 0;
+			ds.offset = 0;
 			goto lookuploop;
 		}
 
@@ -656,7 +737,8 @@ lookuploop:
 	}
 
 exit:
-	free(fid, M_UDFTEMP);
+	if (ds.buf != NULL)
+		udf_dirstream_done(&ds);
 	free(unix_name, M_UDFTEMP);
 
 	return (error);
@@ -753,7 +835,7 @@ udf_getattr(struct vop_getattr_args *ap)
 	vap->va_fsid = dev2udev(ump->devvp->v_rdev);
 	vap->va_fileid = udf_node->hash_id;
 	vap->va_size = filesize;
-	vap->va_blocksize = ump->sector_size; /* wise? */
+	vap->va_blocksize = ump->bsize;
 
 	/* access times */
 	udf_timestamp_to_timespec(ump, atime, &vap->va_atime);
@@ -943,41 +1025,48 @@ udf_readlink(struct vop_readlink_args *ap)
 	struct uio *uio = ap->a_uio;
 	struct pathcomp pathcomp;
 	struct udf_node *udf_node;
+	uint64_t size;
 	int error, filelen, first, len, l_ci, mntonnamelen, namelen, pathlen;
 	int targetlen;
 	char *mntonname;
-	uint8_t *pathbuf, *pathpos, *targetbuf, *targetpos, *tmpname;
+	uint8_t *data, *pathbuf, *pathpos, *targetbuf, *targetpos, *tmpname;
 
 	udf_node = VTOI(vp);
 
-	if (udf_node->efe != NULL)
-		filelen = le64toh(udf_node->efe->inf_len);
-	else
-		filelen = le64toh(udf_node->fe->inf_len);
+	error = udf_intern_data(udf_node, &data, &size);
+	if (error != 0)
+		return (error);
 
-	if (UDF_SYMLINKBUFLEN - 1 < filelen)
+	if (UDF_SYMLINKBUFLEN - 1 < size)
 		return (EINVAL);
+	filelen = size;
 
 	/* claim temporary buffers for translation */
-	pathbuf = malloc(UDF_SYMLINKBUFLEN, M_UDFTEMP, M_WAITOK);
 	targetbuf = malloc(PATH_MAX + 1, M_UDFTEMP, M_WAITOK);
 	tmpname = malloc(PATH_MAX + 1, M_UDFTEMP, M_WAITOK);
-	memset(pathbuf, 0, UDF_SYMLINKBUFLEN);
 	memset(targetbuf, 0, PATH_MAX + 1);
 
-	/* read contents of file in our temporary buffer */
-	error = vn_rdwr(UIO_READ, vp, pathbuf, filelen, 0, UIO_SYSSPACE,
-	    IO_NODELOCKED, FSCRED, NULL, NULL, curthread);
-	if (error != 0) {
-		/* failed to read in symlink contents */
-		free(pathbuf, M_UDFTEMP);
-		free(targetbuf, M_UDFTEMP);
-		free(tmpname, M_UDFTEMP);
-		return (error);
+	/* an embedded symlink is translated in place */
+	pathbuf = NULL;
+	if (data == NULL) {
+		/* read contents of file in our temporary buffer */
+		pathbuf = malloc(UDF_SYMLINKBUFLEN, M_UDFTEMP, M_WAITOK);
+		memset(pathbuf, 0, UDF_SYMLINKBUFLEN);
+		error = vn_rdwr(UIO_READ, vp, pathbuf, filelen, 0,
+		    UIO_SYSSPACE, IO_NODELOCKED, FSCRED, NULL, NULL,
+		    curthread);
+		if (error != 0) {
+			/* failed to read in symlink contents */
+			free(pathbuf, M_UDFTEMP);
+			free(targetbuf, M_UDFTEMP);
+			free(tmpname, M_UDFTEMP);
+			return (error);
+		}
+		data = pathbuf;
 	}
 
 	/* convert to a unix path */
-	pathpos = pathbuf;
+	pathpos = data;
 	pathlen = 0;
 	targetpos = targetbuf;
 	targetlen = PATH_MAX;
@@ -990,6 +1079,10 @@ udf_readlink(struct vop_readlink_args *ap)
 		len = UDF_PATH_COMP_SIZE;
 		memcpy(&pathcomp, pathpos, len);
 		l_ci = pathcomp.l_ci;
+		if (filelen - pathlen < UDF_PATH_COMP_SIZE + l_ci) {
+			error = EINVAL;
+			break;
+		}
 		switch (pathcomp.type) {
 		case UDF_PATH_COMP_ROOT:
 			/* XXX should check for l_ci; bugcompatible now */
@@ -1121,6 +1214,77 @@ udf_vptofh(struct vop_vptofh_args *ap)
 	return (0);
 }
 
+#if __FreeBSD__ < 10
+#define	UDF_OBJECT_WLOCK(object)	VM_OBJECT_LOCK(object)
+#define	UDF_OBJECT_WUNLOCK(object)	VM_OBJECT_UNLOCK(object)
+#define	vm_page_set_valid_range(m, base, size) \
+	vm_page_set_valid(m, base, size)
+#else
+#define	UDF_OBJECT_WLOCK(object)	VM_OBJECT_WLOCK(object)
+#define	UDF_OBJECT_WUNLOCK(object)	VM_OBJECT_WUNLOCK(object)
+#endif
+
+/* read-ahead pages of a fault, finished by udf_getpages_done() */
+struct udf_rapages {
+	struct buf	*bp;		/* pbuf providing the mapping */
+	vm_object_t	 object;
+	off_t		 offset;	/* file offset of pages[0] */
+	off_t		 filesize;
+	int		 count;
+	vm_page_t	 pages[];
+};
+
+/* mark pages read from file offset foff on valid; object is locked */
+static void
+udf_pages_valid(vm_page_t *pages, int count, off_t foff, off_t filesize,
+    int reqpage)
+{
+	int i;
+
+	for (i = 0; i < count; i++, foff += PAGE_SIZE) {
+		if (foff + PAGE_SIZE <= filesize)
+			pages[i]->valid = VM_PAGE_BITS_ALL;
+		else
+			vm_page_set_valid_range(pages[i], 0, filesize - foff);
+
+		if (i != reqpage)
+			vm_page_readahead_finish(pages[i]);
+	}
+}
+
+static void
+udf_getpages_done(void *arg, int error)
+{
+	struct udf_rapages *ra = arg;
+	vm_offset_t kva;
+	int i, size;
+
+	kva = (vm_offset_t)ra->bp->b_data;
+	size = MIN(ptoa(ra->count), ra->filesize - ra->offset);
+	if (error == 0 && size < ptoa(ra->count))
+		bzero((caddr_t)kva + size, ptoa(ra->count) - size);
+	pmap_qremove(kva, ra->count);
+	relpbuf(ra->bp, &udf_pbuf_freecnt);
+
+	/* pages that did not become valid are freed by readahead_finish */
+	UDF_OBJECT_WLOCK(ra->object);
+	if (error == 0)
+		udf_pages_valid(ra->pages, ra->count, ra->offset, ra->filesize,
+		    -1);
+	else
+		for (i = 0; i < ra->count; i++)
+			vm_page_readahead_finish(ra->pages[i]);
+	vm_object_pip_wakeup(ra->object);
+	UDF_OBJECT_WUNLOCK(ra->object);
+
+	free(ra, M_UDFTEMP);
+}
+
+/*
+ * The requested page and those before it are read before returning; the
+ * pages after it are read ahead asynchronously and stay busy until
+ * udf_getpages_done() has filled them in.
+ */
 static int
 udf_getpages(struct vop_getpages_args /* {
 		struct vnode *a_vp;
@@ -1131,206 +1295,98 @@ udf_getpages(struct vop_getpages_args /* {
 	} */ *ap)
 {
 	struct buf *bp;
-	struct bufobj *bo;
 	struct vnode *vp = ap->a_vp;
+	struct udf_node *udf_node = VTOI(vp);
+	struct udf_rapages *ra;
+	vm_object_t object = vp->v_object;
 	vm_page_t *pages;
-	daddr_t startreq, lastreq, firstblk, vblock, address;
-	off_t filesize, foff, tfoff;
-	vm_offset_t kva, curdata;
-	int blksperpage, bsize, error, i, numblks, pagecnt, size;
-	int curpage, fpage, npage;
+	off_t filesize, foff;
+	vm_offset_t kva;
+	int count, error, i, npage, pagecnt, reqpage, size;
 
-	error = 0;
-	bsize = vp->v_mount->mnt_stat.f_iosize;
-	filesize = vp->v_object->un_pager.vnp.vnp_size;
+	filesize = object->un_pager.vnp.vnp_size;
 	pages = ap->a_m;
 	pagecnt = btoc(ap->a_count);
-	blksperpage = PAGE_SIZE / bsize;
+	reqpage = ap->a_reqpage;
 
 	/* 
 	 * Free other pages, if requested page is valid.  If only part of a page
 	 * is marked as valid, we overwrite it below.  This approch would not 
 	 * work, if the filesystem implemented write support.
 	 */
-#if __FreeBSD__ < 10
-	VM_OBJECT_LOCK(vp->v_object);
-#else
-	VM_OBJECT_WLOCK(vp->v_object);
-#endif
-	if (pages[ap->a_reqpage]->valid == VM_PAGE_BITS_ALL) {
+	UDF_OBJECT_WLOCK(object);
+	if (pages[reqpage]->valid == VM_PAGE_BITS_ALL) {
 		for (i = 0; i < pagecnt; i++)
-			if (i != ap->a_reqpage) {
+			if (i != reqpage) {
 				vm_page_lock(pages[i]);
 				vm_page_free(pages[i]);
 				vm_page_unlock(pages[i]);
 			}
-#if __FreeBSD__ < 10
-		VM_OBJECT_UNLOCK(vp->v_object);
-#else
-		VM_OBJECT_WUNLOCK(vp->v_object);
-#endif
+		UDF_OBJECT_WUNLOCK(object);
 		return VM_PAGER_OK;
 	}
-#if __FreeBSD__ < 10
-	VM_OBJECT_UNLOCK(vp->v_object);
-#else
-	VM_OBJECT_WUNLOCK(vp->v_object);
-#endif
-
-	/* Map all memory pages, and then use a single buf object for all 
-	bstrategy calls. */
-	bp = getpbuf(&udf_pbuf_freecnt);
-	bp->b_iocmd = BIO_READ;
-	bp->b_iodone = bdone;
-	bp->b_rcred = crhold(curthread->td_ucred);
-	bp->b_wcred = crhold(curthread->td_ucred);
-
-	curdata = kva = (vm_offset_t)bp->b_data;
-	pmap_qenter(kva, pages, pagecnt);
-
-	firstblk = pages[0]->pindex * blksperpage;
-	startreq = pages[ap->a_reqpage]->pindex * blksperpage;
-	lastreq = startreq + blksperpage - 1;
-	if ((lastreq + 1) * bsize > filesize)
-		lastreq = (filesize - 1) / bsize;
-	fpage = -1;
-
-	for (curpage = 0, vblock = firstblk; vblock <= lastreq; ) {
-		error = VOP_BMAP(vp, vblock, &bo, &address, &numblks, NULL);
-		if (error)
-			goto error;
-
-		numblks++;
-		if (vblock + numblks <= startreq) {
-			vblock += numblks - 1; /* last block of run */
-			npage = (vblock - firstblk) / blksperpage + 1;
-			vblock = pages[npage]->pindex * blksperpage; 
-			curdata = kva + IDX_TO_OFF(pages[npage]->pindex);
-			continue;
-		} 
-
-		curpage = ((vblock - firstblk) * bsize) / PAGE_SIZE;
-
-		/* find number of blocks to readahead */
-		numblks = MIN(numblks, 
-		    blksperpage * pagecnt - (vblock - firstblk));
-		if (vblock + numblks - 1 > lastreq)
-			numblks -= (vblock - firstblk + numblks) % blksperpage;
-		size = bsize * numblks;
-
-		/* from initpbuf() */
-		bp->b_qindex = 0;
-		bp->b_xflags = 0;
-		bp->b_flags = 0;
-		bp->b_ioflags = 0;
-		bp->b_iodone = NULL;
-		bp->b_error = 0;
-
-		/* setup the buffer for this run */
-		if (fpage == -1) {
-			pbgetbo(bo, bp);
-			bp->b_vp = vp;
-			fpage = curpage;
-		}
-
-		bp->b_data = (caddr_t)curdata;
-		bp->b_blkno = address;
-		bp->b_lblkno = vblock;
-		bp->b_bcount = size; /* this is the current read size. */
-		bp->b_bufsize = size;
-		bp->b_runningbufspace = bp->b_bufsize;
-		atomic_add_long(&runningbufspace, bp->b_runningbufspace);
-
-		bp->b_iooffset = dbtob(bp->b_blkno);
-		bstrategy(bp);
-
-		bwait(bp, PVM, "udfvnread");
 
-		if ((bp->b_ioflags & BIO_ERROR) != 0) {
-			error = EIO;
-			goto error;
-		}
-
-		vblock = vblock + numblks;
-		curdata += size;
+	/* remove all pages beyond the end of the file */
+	foff = IDX_TO_OFF(pages[0]->pindex);
+	npage = MIN(pagecnt, btoc(filesize - foff));
+	for (i = npage; i < pagecnt; i++) {
+		vm_page_lock(pages[i]);
+		vm_page_free(pages[i]);
+		vm_page_unlock(pages[i]);
 	}
-
-	/* it should error out before here if vblock == firstblk */
-	npage = (vblock - 1 - firstblk) / blksperpage + 1;
-
-	if ((vblock - firstblk) % blksperpage != 0) {
-		bzero((caddr_t) curdata, 
-		    ((vblock - firstblk) % blksperpage) * bsize);
+	if (reqpage + 1 < npage)
+		vm_object_pip_add(object, 1);
+	UDF_OBJECT_WUNLOCK(object);
+
+	/* start reading ahead */
+	if (reqpage + 1 < npage) {
+		count = npage - reqpage - 1;
+		ra = malloc(sizeof(struct udf_rapages) +
+		    count * sizeof(vm_page_t), M_UDFTEMP, M_WAITOK);
+		ra->bp = getpbuf(&udf_pbuf_freecnt);
+		ra->object = object;
+		ra->offset = foff + ptoa(reqpage + 1);
+		ra->filesize = filesize;
+		ra->count = count;
+		memcpy(ra->pages, pages + reqpage + 1,
+		    count * sizeof(vm_page_t));
+		pmap_qenter((vm_offset_t)ra->bp->b_data, ra->pages, count);
+
+		udf_read_node_async(udf_node, (uint8_t *)ra->bp->b_data,
+		    ra->offset, MIN(ptoa(count), filesize - ra->offset),
+		    udf_getpages_done, ra);
+		npage = reqpage + 1;
 	}
 
-error:
-	pmap_qremove(kva, pagecnt);
+	/*
+	 * Map the remaining pages and read the file data straight into them;
+	 * this does not depend on the block size used by the buffer cache.
+	 */
+	bp = getpbuf(&udf_pbuf_freecnt);
+	kva = (vm_offset_t)bp->b_data;
+	pmap_qenter(kva, pages, npage);
+
+	size = MIN(ptoa(npage), filesize - foff);
+	error = udf_read_node_direct(udf_node, (uint8_t *)kva, foff, size);
+	if (error == 0 && size < ptoa(npage))
+		bzero((caddr_t)kva + size, ptoa(npage) - size);
 
-	bp->b_vp = NULL;
-	pbrelbo(bp);
-	relpbuf(bp, &vnode_pbuf_freecnt);
+	pmap_qremove(kva, npage);
+	relpbuf(bp, &udf_pbuf_freecnt);
 
+	UDF_OBJECT_WLOCK(object);
 	if (error != 0) {
-#if __FreeBSD__ < 10
-		VM_OBJECT_LOCK(vp->v_object);
-#else
-		VM_OBJECT_WLOCK(vp->v_object);
-#endif
-		for (i = 0; i < pagecnt; i++)
-			if (i != ap->a_reqpage) {
+		for (i = 0; i < npage; i++)
+			if (i != reqpage) {
 				vm_page_lock(pages[i]);
 				vm_page_free(pages[i]);
 				vm_page_unlock(pages[i]);
 			}
-#if __FreeBSD__ < 10
-		VM_OBJECT_UNLOCK(vp->v_object);
-#else
-		VM_OBJECT_WUNLOCK(vp->v_object);
-#endif
+		UDF_OBJECT_WUNLOCK(object);
 		return (VM_PAGER_ERROR);
 	}
-
-#if __FreeBSD__ < 10
-	VM_OBJECT_LOCK(vp->v_object);
-#else
-	VM_OBJECT_WLOCK(vp->v_object);
-#endif
-	/* remove all pages before first loaded page. */
-	for (i = 0; i < fpage; i++) {
-		vm_page_lock(pages[i]);
-		vm_page_free(pages[i]);
-		vm_page_unlock(pages[i]);
-	}
-
-	/* mark filled pages. */
-	foff = IDX_TO_OFF(pages[fpage]->pindex);
-	for (i = fpage, tfoff = foff; i < npage; i++, tfoff += PAGE_SIZE) {
-		/* We only read complete pages above. */
-		if (tfoff + PAGE_SIZE <= filesize)
-			pages[i]->valid = VM_PAGE_BITS_ALL;
-		else {
-#if __FreeBSD__ < 10
-			vm_page_set_valid(pages[i], 0, filesize - tfoff);
-#else
-			vm_page_set_valid_range(pages[i], 0, filesize - tfoff);
-#endif
-		}
-
-		if (i != ap->a_reqpage)
-			vm_page_readahead_finish(pages[i]);
-	}
-
-	/* remove all pages after last loaded page. */
-	for (i = npage; i < pagecnt; i++) {
-		vm_page_lock(pages[i]);
-		vm_page_free(pages[i]);
-		vm_page_unlock(pages[i]);
-	}
-#if __FreeBSD__ < 10
-	VM_OBJECT_UNLOCK(vp->v_object);
-#else
-	VM_OBJECT_WUNLOCK(vp->v_object);
-#endif
+	udf_pages_valid(pages, npage, foff, filesize, reqpage);
+	UDF_OBJECT_WUNLOCK(object);
 
 	return (VM_PAGER_OK);
 }
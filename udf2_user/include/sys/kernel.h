@@ -0,0 +1,2 @@
+/* userland stand-in, see udf_user.h */
+#include <udf_user.h>
@@ -0,0 +1,585 @@
+/*-
+ * Copyright (c) 2026 The udf2 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Userland implementation of the kernel services the udf2 core relies on,
+ * and the mount sequence of udf_mountfs() on top of an image file.
+ */
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "udf_user.h"
+#include "ecma167-udf.h"
+#include "udf.h"
+#include "udf_subr.h"
+
+MALLOC_DEFINE(M_TEMP, "temp", "misc temporary data buffers");
+MALLOC_DEFINE(M_UDFTEMP, "UDF temp", "UDF allocation space");
+
+struct thread *curthread = NULL;
+struct iconv_functions *udf2_iconv = NULL;
+struct udf_user_iostat udf_user_iostat;
+u_int udf_user_latency = 0;
+int udf_user_serialize = 0;
+
+static struct timespec udf_user_busy;	/* device done with its queue */
+
+void *
+udf_user_malloc(size_t size, struct malloc_type *type, int flags)
+{
+	void *addr;
+
+	if (flags & M_ZERO)
+		addr = calloc(1, MAX(size, 1));
+	else
+		addr = malloc(MAX(size, 1));
+	if (addr == NULL && (flags & M_NOWAIT) == 0)
+		panic("%s: out of memory for %zu bytes", type->ks_shortdesc,
+		    size);
+
+	return (addr);
+}
+
+void *
+udf_user_realloc(void *addr, size_t size, struct malloc_type *type, int flags)
+{
+	void *naddr;
+
+	naddr = realloc(addr, MAX(size, 1));
+	if (naddr == NULL && (flags & M_NOWAIT) == 0)
+		panic("%s: out of memory for %zu bytes", type->ks_shortdesc,
+		    size);
+
+	return (naddr);
+}
+
+void
+udf_user_free(void *addr, struct malloc_type *type)
+{
+
+	free(addr);
+}
+
+void
+panic(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "panic: ");
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+
+	abort();
+}
+
+/*
+ * read from the image; past its end counts as an I/O error, unless
+ * `completed' is given, which then tells how much could be read like
+ * GEOM does for a request crossing the end of the media
+ */
+static int
+udf_user_pread(int fd, void *data, size_t len, off_t offset,
+    off_t *completed)
+{
+	ssize_t n;
+	uint8_t *pos;
+
+	udf_user_iostat.reads++;
+	udf_user_iostat.bytes += len;
+
+	pos = data;
+	if (completed != NULL)
+		*completed = 0;
+	while (len > 0) {
+		n = pread(fd, pos, len, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return (errno);
+		}
+		if (n == 0)
+			return (completed != NULL ? 0 : EIO);
+		if (completed != NULL)
+			*completed += n;
+		pos += n;
+		len -= n;
+		offset += n;
+	}
+
+	return (0);
+}
+
+/* when a request issued now completes with the injected latency */
+static void
+udf_user_ready(struct timespec *ready)
+{
+
+	clock_gettime(CLOCK_MONOTONIC, ready);
+	if (udf_user_latency == 0)
+		return;
+	if (udf_user_serialize && (udf_user_busy.tv_sec > ready->tv_sec ||
+	    (udf_user_busy.tv_sec == ready->tv_sec &&
+	    udf_user_busy.tv_nsec > ready->tv_nsec)))
+		*ready = udf_user_busy;
+	ready->tv_nsec += udf_user_latency * 1000L;
+	ready->tv_sec += ready->tv_nsec / 1000000000L;
+	ready->tv_nsec %= 1000000000L;
+	udf_user_busy = *ready;
+}
+
+static void
+udf_user_wait(const struct timespec *ready)
+{
+
+	if (udf_user_latency == 0)
+		return;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, ready,
+	    NULL) == EINTR)
+		continue;
+}
+
+int
+bread(struct vnode *vp, daddr_t blkno, int size, struct ucred *cred,
+    struct buf **bpp)
+{
+	struct timespec ready;
+	struct buf *bp;
+
+	udf_user_ready(&ready);
+
+	bp = udf_user_malloc(sizeof(struct buf), M_TEMP, M_WAITOK | M_ZERO);
+	bp->b_data = udf_user_malloc(size, M_TEMP, M_WAITOK);
+	bp->b_bcount = size;
+	bp->b_error = udf_user_pread(vp->v_fd, bp->b_data, size,
+	    (off_t)blkno * DEV_BSIZE, NULL);
+	udf_user_wait(&ready);
+
+	*bpp = bp;
+	return (bp->b_error);
+}
+
+void
+brelse(struct buf *bp)
+{
+
+	free(bp->b_data);
+	free(bp);
+}
+
+struct bio *
+g_alloc_bio(void)
+{
+
+	return (udf_user_malloc(sizeof(struct bio), M_TEMP,
+	    M_WAITOK | M_ZERO));
+}
+
+void
+g_destroy_bio(struct bio *bp)
+{
+
+	free(bp);
+}
+
+/*
+ * The request is carried out at once, but only complete once its injected
+ * latency is over.  There are no threads for completions, so a bio_done
+ * callback waits for it here.
+ */
+void
+g_io_request(struct bio *bp, struct g_consumer *cp)
+{
+
+	udf_user_ready(&bp->bio_ready);
+	if (bp->bio_cmd == BIO_READ)
+		bp->bio_error = udf_user_pread(cp->fd, bp->bio_data,
+		    bp->bio_length, bp->bio_offset, &bp->bio_completed);
+	else
+		bp->bio_error = EOPNOTSUPP;
+	if (bp->bio_error != 0)
+		bp->bio_flags |= BIO_ERROR;
+
+	if (bp->bio_done != NULL) {
+		udf_user_wait(&bp->bio_ready);
+		bp->bio_done(bp);
+	}
+}
+
+int
+biowait(struct bio *bp, const char *wchan)
+{
+
+	udf_user_wait(&bp->bio_ready);
+	return (bp->bio_error);
+}
+
+struct udf_node *
+udf_alloc_node(void)
+{
+
+	return (udf_user_malloc(sizeof(struct udf_node), M_UDFTEMP,
+	    M_WAITOK | M_ZERO));
+}
+
+void
+udf_free_node(struct udf_node *unode)
+{
+
+	free(unode);
+}
+
+/*
+ * Vnodes are not shared; every udf_vget() returns a fresh vnode that is
+ * released again with vput().
+ */
+int
+udf_vget(struct mount *mp, ino_t ino, int flags, struct vnode **vpp)
+{
+	struct udf_mount *ump = mp->mnt_data;
+	struct udf_node *unode;
+	struct vnode *vp;
+	struct long_ad icb;
+	int error, udf_file_type;
+
+	*vpp = NULL;
+
+	udf_get_node_longad(ino, &icb);
+	error = udf_get_node(ump, icb, &unode);
+	if (error != 0)
+		return (error);
+
+	vp = udf_user_malloc(sizeof(struct vnode), M_TEMP, M_WAITOK | M_ZERO);
+	vp->v_mount = mp;
+	vp->v_data = unode;
+	vp->v_fd = -1;
+	unode->vnode = vp;
+	unode->hash_id = ino;
+
+	if (unode->fe != NULL)
+		udf_file_type = unode->fe->icbtag.file_type;
+	else
+		udf_file_type = unode->efe->icbtag.file_type;
+
+	switch (udf_file_type) {
+	case UDF_ICB_FILETYPE_DIRECTORY:
+	case UDF_ICB_FILETYPE_STREAMDIR:
+		vp->v_type = VDIR;
+		break;
+	case UDF_ICB_FILETYPE_SYMLINK:
+		vp->v_type = VLNK;
+		break;
+	case UDF_ICB_FILETYPE_RANDOMACCESS:
+	case UDF_ICB_FILETYPE_REALTIME:
+		vp->v_type = VREG;
+		break;
+	default:
+		vp->v_type = VNON;
+		break;
+	}
+
+	*vpp = vp;
+	return (0);
+}
+
+void
+vgone(struct vnode *vp)
+{
+
+	/* nothing to do, vput() releases everything */
+}
+
+void
+vput(struct vnode *vp)
+{
+
+	if (vp->v_data != NULL)
+		udf_dispose_node(vp->v_data);
+	free(vp);
+}
+
+int
+vn_rdwr(enum uio_rw rw, struct vnode *vp, void *base, int len, off_t offset,
+    enum uio_seg segflg, int ioflg, struct ucred *active_cred,
+    struct ucred *file_cred, ssize_t *aresid, struct thread *td)
+{
+	struct udf_node *unode = vp->v_data;
+	uint64_t file_size;
+	int error, n;
+
+	if (rw != UIO_READ)
+		return (EROFS);
+
+	if (unode->fe != NULL)
+		file_size = le64toh(unode->fe->inf_len);
+	else
+		file_size = le64toh(unode->efe->inf_len);
+
+	n = 0;
+	if ((uint64_t)offset < file_size)
+		n = MIN((uint64_t)len, file_size - offset);
+
+	error = 0;
+	if (n > 0)
+		error = udf_read_node(unode, base, offset, n);
+	if (aresid != NULL)
+		*aresid = len - n;
+
+	return (error);
+}
+
+/*
+ * Mount the UDF file system on image file `image', following the steps of
+ * udf_mountfs().  The image is treated as a single closed session.
+ */
+int
+udf_user_mount(const char *image, u_int sector_size, struct udf_mount **ump)
+{
+	struct udf_mount *nump;
+	struct mount *mp;
+	struct vnode *devvp;
+	struct g_consumer *cp;
+	struct stat st;
+	uint32_t numsecs;
+	int error, fd, snapshot;
+
+	*ump = NULL;
+	if (sector_size < 512 || sector_size >= 8192 ||
+	    (sector_size & (sector_size - 1)) != 0)
+		return (EINVAL);
+
+	fd = open(image, O_RDONLY);
+	if (fd < 0)
+		return (errno);
+	if (fstat(fd, &st) < 0) {
+		error = errno;
+		close(fd);
+		return (error);
+	}
+
+	mp = udf_user_malloc(sizeof(struct mount), M_TEMP, M_WAITOK | M_ZERO);
+	mp->mnt_iosize_max = MAXPHYS;
+	mp->mnt_stat.f_iosize = sector_size;
+	mp->mnt_stat.f_bsize = sector_size;
+
+	devvp = udf_user_malloc(sizeof(struct vnode), M_TEMP,
+	    M_WAITOK | M_ZERO);
+	devvp->v_type = VBLK;
+	devvp->v_fd = fd;
+
+	cp = udf_user_malloc(sizeof(struct g_consumer), M_TEMP,
+	    M_WAITOK | M_ZERO);
+	cp->provider = udf_user_malloc(sizeof(struct g_provider), M_TEMP,
+	    M_WAITOK | M_ZERO);
+	cp->provider->mediasize = st.st_size;
+	cp->provider->sectorsize = sector_size;
+	cp->fd = fd;
+
+	nump = udf_user_malloc(sizeof(struct udf_mount), M_UDFTEMP,
+	    M_WAITOK | M_ZERO);
+	mp->mnt_data = nump;
+	nump->vfs_mountp = mp;
+	nump->devvp = devvp;
+	nump->geomcp = cp;
+	nump->anon_uid = getuid();
+	nump->anon_gid = getgid();
+	nump->sector_size = sector_size;
+
+	numsecs = st.st_size / sector_size;
+	nump->session_start = 0;
+	nump->session_end = numsecs;
+	nump->session_last_written = numsecs;
+	nump->last_possible_vat_location = nump->session_last_written;
+
+	*ump = nump;
+
+	if (udf_read_anchors(nump) == 0) {
+		error = EINVAL;
+		goto fail;
+	}
+	if ((error = udf_read_vds_space(nump)) != 0)
+		goto fail;
+	if ((error = udf_process_vds(nump)) != 0)
+		goto fail;
+	snapshot = udf_restore_snapshot(nump) == 0;
+	if (!snapshot && (error = udf_read_vds_tables(nump)) != 0)
+		goto fail;
+	if ((error = udf_read_rootdirs(nump)) != 0)
+		goto fail;
+	if (!snapshot)
+		udf_save_snapshot(nump);
+
+	return (0);
+
+fail:
+	udf_user_unmount(nump);
+	*ump = NULL;
+	return (error);
+}
+
+void
+udf_user_unmount(struct udf_mount *ump)
+{
+	struct mount *mp;
+	int i;
+
+	if (ump == NULL)
+		return;
+
+	if (ump->metadata_node != NULL)
+		udf_dispose_node(ump->metadata_node);
+	if (ump->metadata_mirror_node != NULL)
+		udf_dispose_node(ump->metadata_mirror_node);
+
+	for (i = 0; i < UDF_ANCHORS; i++)
+		free(ump->anchors[i]);
+	free(ump->primary_vol);
+	free(ump->logical_vol);
+	free(ump->unallocated);
+	free(ump->implementation);
+	free(ump->logvol_integrity);
+	for (i = 0; i < UDF_PARTITIONS; i++)
+		free(ump->partitions[i]);
+	free(ump->fileset_desc);
+	free(ump->sparing_table);
+	free(ump->sparing_map);
+	udf_free_vat(ump);
+	free(ump->dscr_win);
+	free(ump->dscr_alt);
+
+	close(ump->geomcp->fd);
+	free(ump->geomcp->provider);
+	free(ump->geomcp);
+	free(ump->devvp);
+	mp = ump->vfs_mountp;
+	free(ump);
+	free(mp);
+}
+
+int
+udf_user_root(struct udf_mount *ump, struct vnode **vpp)
+{
+	ino_t ino;
+	int error;
+
+	error = udf_get_node_id(ump->fileset_desc->rootdir_icb, &ino);
+	if (error != 0)
+		return (error);
+
+	return (udf_vget(ump->vfs_mountp, ino, LK_EXCLUSIVE, vpp));
+}
+
+/* look up one path component in directory dvp, as udf_cachedlookup() */
+int
+udf_user_lookup(struct vnode *dvp, const char *name, struct vnode **vpp)
+{
+	struct udf_node *dir_node = dvp->v_data;
+	struct udf_dirstream ds;
+	struct fileid_desc *fid;
+	ino_t id;
+	int error, isdotdot;
+	char unix_name[MAXNAMLEN + 1];
+
+	*vpp = NULL;
+	if (dvp->v_type != VDIR)
+		return (ENOTDIR);
+	if (strcmp(name, ".") == 0)
+		return (udf_vget(dvp->v_mount, dir_node->hash_id, LK_SHARED,
+		    vpp));
+	isdotdot = strcmp(name, "..") == 0;
+
+	id = 0;
+	udf_dirstream_init(&ds, dvp, 0);
+	for (;;) {
+		error = udf_dirstream_next(&ds, &fid);
+		if (error != 0 || fid == NULL)
+			break;
+		if (fid->file_char & (UDF_FILE_CHAR_DEL | UDF_FILE_CHAR_VIS))
+			continue;
+		if (fid->file_char & UDF_FILE_CHAR_PAR) {
+			if (isdotdot) {
+				error = udf_get_node_id(fid->icb, &id);
+				break;
+			}
+			continue;
+		}
+		if (isdotdot)
+			continue;
+
+		udf_to_unix_name(dir_node->ump, unix_name, MAXNAMLEN,
+		    fid->data + le16toh(fid->l_iu), fid->l_fi);
+		if (strcmp(unix_name, name) == 0) {
+			error = udf_get_node_id(fid->icb, &id);
+			break;
+		}
+	}
+	udf_dirstream_done(&ds);
+
+	if (error != 0)
+		return (error);
+	if (id == 0)
+		return (ENOENT);
+
+	return (udf_vget(dvp->v_mount, id, LK_SHARED, vpp));
+}
+
+int
+udf_user_namei(struct udf_mount *ump, const char *path, struct vnode **vpp)
+{
+	struct vnode *dvp, *vp;
+	const char *cp, *ep;
+	char name[MAXNAMLEN + 1];
+	int error;
+
+	error = udf_user_root(ump, &vp);
+	for (cp = path; error == 0; cp = ep) {
+		while (*cp == '/')
+			cp++;
+		if (*cp == '\0')
+			break;
+		ep = cp;
+		while (*ep != '\0' && *ep != '/')
+			ep++;
+		if (ep - cp > MAXNAMLEN) {
+			error = ENAMETOOLONG;
+			break;
+		}
+		memcpy(name, cp, ep - cp);
+		name[ep - cp] = '\0';
+
+		dvp = vp;
+		error = udf_user_lookup(dvp, name, &vp);
+		vput(dvp);
+	}
+
+	*vpp = (error == 0) ? vp : NULL;
+	return (error);
+}
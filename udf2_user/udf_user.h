@@ -0,0 +1,279 @@
+/*-
+ * Copyright (c) 2026 The udf2 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Userland stand-ins for the kernel interfaces used by the udf2 core files.
+ * The stub headers under include/ all resolve to this file.  Only what the
+ * core actually uses is provided; the device is an image file read with
+ * pread(2).
+ */
+
+#ifndef _UDF_USER_H_
+#define _UDF_USER_H_
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <endian.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __packed	__attribute__((__packed__))
+
+#ifndef EDOOFUS
+#define EDOOFUS		EINVAL
+#endif
+
+#define DEV_BSIZE	512
+#define MAXBSIZE	65536
+#define MAXPHYS		(128 * 1024)
+#ifndef MAXNAMLEN
+#define MAXNAMLEN	255
+#endif
+#ifndef MAXPATHLEN
+#define MAXPATHLEN	1024
+#endif
+
+#ifndef MIN
+#define MIN(a, b)	(((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)	(((a) > (b)) ? (a) : (b))
+#endif
+#define howmany(x, y)	(((x) + ((y) - 1)) / (y))
+#define roundup(x, y)	((((x) + ((y) - 1)) / (y)) * (y))
+#define roundup2(x, y)	(((x) + ((y) - 1)) & (~((y) - 1)))
+#define rounddown(x, y)	(((x) / (y)) * (y))
+
+static __inline int imin(int a, int b) { return (a < b ? a : b); }
+static __inline int imax(int a, int b) { return (a > b ? a : b); }
+static __inline u_int min(u_int a, u_int b) { return (a < b ? a : b); }
+static __inline u_int max(u_int a, u_int b) { return (a > b ? a : b); }
+static __inline u_long ulmin(u_long a, u_long b) { return (a < b ? a : b); }
+
+#define KASSERT(exp, msg)	do { } while (0)
+
+/* credentials and threads are not used in userland */
+struct ucred;
+struct thread;
+extern struct thread *curthread;
+#define NOCRED		((struct ucred *)0)
+#define FSCRED		((struct ucred *)1)
+
+/* reference counts and atomics; single threaded, so plain operations */
+#define refcount_init(count, value)	(*(count) = (value))
+#define refcount_acquire(count)		((void)++*(count))
+#define refcount_release(count)		(--*(count) == 0)
+#define atomic_cmpset_int(dst, expect, src) \
+	(*(dst) == (expect) ? (*(dst) = (src), 1) : 0)
+#define atomic_add_long(dst, val)	((void)(*(dst) += (val)))
+
+/* memory */
+struct malloc_type {
+	const char	*ks_shortdesc;
+};
+#define MALLOC_DECLARE(type)	extern struct malloc_type type[1]
+#define MALLOC_DEFINE(type, shortdesc, longdesc) \
+	struct malloc_type type[1] = { { shortdesc } }
+MALLOC_DECLARE(M_TEMP);
+MALLOC_DECLARE(M_UDFTEMP);
+
+#define M_NOWAIT	0x0001
+#define M_WAITOK	0x0002
+#define M_ZERO		0x0100
+
+void	*udf_user_malloc(size_t size, struct malloc_type *type, int flags);
+void	*udf_user_realloc(void *addr, size_t size, struct malloc_type *type,
+	    int flags);
+void	 udf_user_free(void *addr, struct malloc_type *type);
+void	 panic(const char *fmt, ...) __attribute__((__noreturn__));
+
+#ifdef _KERNEL
+#define malloc(size, type, flags)	udf_user_malloc(size, type, flags)
+#define realloc(addr, size, type, flags) \
+	udf_user_realloc(addr, size, type, flags)
+#define free(addr, type)		udf_user_free(addr, type)
+#endif
+
+/* locking; the userland library is single threaded */
+#define LK_TYPE_MASK	0x0000ff
+#define LK_EXCLUSIVE	0x080000
+#define LK_SHARED	0x200000
+
+struct mtx {
+	int		 mtx_unused;
+};
+#define MTX_DEF		0x0000
+#define MTX_SYSINIT(name, mtx, desc, opts)	struct __hack
+#define mtx_init(m, name, type, opts)	((void)(m))
+#define mtx_destroy(m)	((void)(m))
+#define mtx_lock(m)	((void)(m))
+#define mtx_unlock(m)	((void)(m))
+
+struct sx {
+	int		 sx_unused;
+};
+#define SX_SYSINIT(name, sx, desc)	struct __hack
+#define sx_xlock(sx)	((void)(sx))
+#define sx_xunlock(sx)	((void)(sx))
+#define sx_slock(sx)	((void)(sx))
+#define sx_sunlock(sx)	((void)(sx))
+#define sx_init(sx, name)	((void)(sx))
+#define sx_destroy(sx)	((void)(sx))
+#define sx_downgrade(sx)	((void)(sx))
+
+/* sysctl knobs are plain variables */
+#define SYSCTL_DECL(name)	struct __hack
+#define SYSCTL_INT(parent, nbr, name, access, ptr, val, descr) \
+	struct __hack
+#define SYSCTL_UINT(parent, nbr, name, access, ptr, val, descr) \
+	struct __hack
+#define SYSCTL_LONG(parent, nbr, name, access, ptr, val, descr) \
+	struct __hack
+
+/* vnodes; device vnodes carry the image file descriptor */
+enum vtype { VNON, VREG, VDIR, VBLK, VCHR, VLNK, VSOCK, VFIFO, VBAD };
+#define VV_ROOT		0x0001
+
+struct mount;
+
+struct vnode {
+	enum vtype	 v_type;
+	int		 v_vflag;
+	struct mount	*v_mount;
+	void		*v_data;
+	int		 v_fd;
+};
+
+struct statfs {
+	uint64_t	 f_iosize;
+	uint64_t	 f_bsize;
+};
+
+struct mount {
+	struct statfs	 mnt_stat;
+	int		 mnt_flag;
+	u_int		 mnt_iosize_max;
+	void		*mnt_data;
+};
+
+void	vgone(struct vnode *vp);
+void	vput(struct vnode *vp);
+
+enum uio_rw	{ UIO_READ, UIO_WRITE };
+enum uio_seg	{ UIO_USERSPACE, UIO_SYSSPACE, UIO_NOCOPY };
+#define IO_NODELOCKED	0x0008
+
+int	vn_rdwr(enum uio_rw rw, struct vnode *vp, void *base, int len,
+	    off_t offset, enum uio_seg segflg, int ioflg,
+	    struct ucred *active_cred, struct ucred *file_cred,
+	    ssize_t *aresid, struct thread *td);
+
+/* buffer cache */
+struct buf {
+	caddr_t		 b_data;
+	long		 b_bcount;
+	int		 b_error;
+};
+
+int	bread(struct vnode *vp, daddr_t blkno, int size, struct ucred *cred,
+	    struct buf **bpp);
+void	brelse(struct buf *bp);
+
+/* GEOM; requests are served synchronously from the image file */
+struct g_provider {
+	off_t		 mediasize;
+	u_int		 sectorsize;
+};
+
+struct g_consumer {
+	struct g_provider *provider;
+	int		 fd;
+};
+
+struct bio {
+	int		 bio_cmd;
+	int		 bio_flags;
+	off_t		 bio_offset;
+	off_t		 bio_length;
+	caddr_t		 bio_data;
+	int		 bio_error;
+	off_t		 bio_completed;
+	void		(*bio_done)(struct bio *);
+	void		*bio_caller1;
+	void		*bio_caller2;
+	struct timespec	 bio_ready;	/* completion with injected latency */
+};
+#define BIO_READ	0x01
+#define BIO_ERROR	0x01
+
+struct bio *g_alloc_bio(void);
+void	g_destroy_bio(struct bio *bp);
+void	g_io_request(struct bio *bp, struct g_consumer *cp);
+int	biowait(struct bio *bp, const char *wchan);
+
+/* character set conversion is not available */
+struct iconv_functions {
+	int	(*open)(const char *to, const char *from, void **handle);
+	int	(*close)(void *handle);
+	size_t	(*conv)(void *handle, const char **inbuf, size_t *inbytesleft,
+		    char **outbuf, size_t *outbytesleft);
+	size_t	(*convchr)(void *handle, const char **inbuf,
+		    size_t *inbytesleft, char **outbuf, size_t *outbytesleft);
+};
+
+/* library entry points */
+struct udf_mount;
+
+/* requests that reached the image, for the benchmarks */
+struct udf_user_iostat {
+	uint64_t	reads;
+	uint64_t	bytes;
+};
+extern struct udf_user_iostat udf_user_iostat;
+
+/*
+ * latency injected into every request, in microseconds; requests in flight
+ * together overlap unless udf_user_serialize makes the device take them one
+ * at a time
+ */
+extern u_int udf_user_latency;
+extern int udf_user_serialize;
+
+int	udf_user_mount(const char *image, u_int sector_size,
+	    struct udf_mount **ump);
+void	udf_user_unmount(struct udf_mount *ump);
+int	udf_user_root(struct udf_mount *ump, struct vnode **vpp);
+int	udf_user_lookup(struct vnode *dvp, const char *name,
+	    struct vnode **vpp);
+int	udf_user_namei(struct udf_mount *ump, const char *path,
+	    struct vnode **vpp);
+
+#endif /* !_UDF_USER_H_ */
@@ -0,0 +1,808 @@
+/*-
+ * Copyright (c) 2026 The udf2 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * udfbench: microbenchmarks of the udf2 core code.  Each one times the
+ * code as it is now against a reference implementation of what it used to
+ * do, on synthetic data or on the sectors of an image, and checks that both
+ * give the same results.
+ *
+ *	udfbench extents [count]
+ *	udfbench read image path ...
+ *	udfbench sparing [lookups]
+ *	udfbench cksum [megabytes]
+ *	udfbench tags image [passes]
+ *	udfbench mount image [latency_us [mounts]]
+ */
+
+#include <err.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "udf_user.h"
+#include "ecma167-udf.h"
+#include "udf.h"
+#include "udf_subr.h"
+#include "udf_osta.h"
+
+#define BENCH_SECTOR	2048
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "usage: udfbench extents [count]\n"
+	    "       udfbench read image path ...\n"
+	    "       udfbench sparing [lookups]\n"
+	    "       udfbench cksum [megabytes]\n"
+	    "       udfbench tags image [passes]\n"
+	    "       udfbench mount image [latency_us [mounts]]\n");
+	exit(1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*
+ * A mount with one physical partition covering the whole 32 bit block
+ * range, enough for the translation code.
+ */
+static struct udf_mount *
+fake_mount(void)
+{
+	static struct mount mp;
+	struct udf_mount *ump;
+	struct part_desc *pdesc;
+
+	mp.mnt_iosize_max = MAXPHYS;
+
+	ump = calloc(1, sizeof(struct udf_mount));
+	ump->logical_vol = calloc(1, sizeof(struct logvol_desc));
+	pdesc = calloc(1, sizeof(struct part_desc));
+	if (ump == NULL || ump->logical_vol == NULL || pdesc == NULL)
+		err(1, "calloc");
+
+	ump->vfs_mountp = &mp;
+	ump->sector_size = BENCH_SECTOR;
+	ump->logical_vol->lb_size = htole32(BENCH_SECTOR);
+	pdesc->start_loc = htole32(0);
+	pdesc->part_len = htole32(UINT32_MAX - 1);
+	ump->partitions[0] = pdesc;
+	ump->vtop[0] = 0;
+	ump->vtop_tp[0] = UDF_VTOP_TYPE_PHYS;
+
+	return (ump);
+}
+
+static void
+free_fake_mount(struct udf_mount *ump)
+{
+
+	free(ump->partitions[0]);
+	free(ump->logical_vol);
+	free(ump);
+}
+
+/*
+ * Reference for udf_bmap_translate() as it was: restart at the first
+ * allocation descriptor and add up lengths until the block is reached.
+ */
+static int
+ref_bmap_translate(struct udf_node *unode, uint32_t block, uint64_t *lsector,
+    uint32_t *maxblks)
+{
+	struct long_ad s_ad;
+	uint64_t foffset, target;
+	int eof, slot;
+	uint32_t len;
+
+	target = (uint64_t)block * BENCH_SECTOR;
+	foffset = 0;
+	for (slot = 0; ; slot++) {
+		udf_get_adslot(unode, slot, &s_ad, &eof);
+		if (eof)
+			return (EINVAL);
+		len = UDF_EXT_LEN(le32toh(s_ad.len));
+		if (foffset + len > target)
+			break;
+		foffset += len;
+	}
+	*lsector = le32toh(s_ad.loc.lb_num) + (target - foffset) / BENCH_SECTOR;
+	*maxblks = (foffset + len - target) / BENCH_SECTOR;
+
+	return (0);
+}
+
+/*
+ * Map every block of a file fragmented into `count' extents of a few
+ * blocks each, one call per block, through the per-node extent map and by
+ * rescanning the allocation descriptors.
+ */
+static int
+bench_extents(int argc, char **argv)
+{
+	struct udf_mount *ump;
+	struct udf_node *unode;
+	struct file_entry *fe;
+	uint64_t lsector, ref_lsector, total;
+	double t0, t_map, t_ref;
+	int count, error, exttype, i;
+	uint32_t blk, lb, maxblks, nblks, ref_maxblks;
+
+	count = argc > 0 ? atoi(argv[0]) : 10000;
+	if (count <= 0)
+		usage();
+
+	ump = fake_mount();
+	unode = calloc(1, sizeof(struct udf_node));
+	fe = calloc(1, sizeof(struct file_entry));
+	unode->adslots = calloc(count, sizeof(struct long_ad));
+	if (unode == NULL || fe == NULL || unode->adslots == NULL)
+		err(1, "calloc");
+
+	/* extents of 1 to 8 blocks with a gap behind each */
+	srandom(1);
+	total = 0;
+	lb = 1000;
+	for (i = 0; i < count; i++) {
+		nblks = 1 + random() % 8;
+		unode->adslots[i].len = htole32(nblks * BENCH_SECTOR);
+		unode->adslots[i].loc.lb_num = htole32(lb);
+		lb += nblks + 1;
+		total += nblks;
+	}
+	unode->num_adslots = count;
+	fe->icbtag.flags = htole16(UDF_ICB_LONG_ALLOC);
+	fe->inf_len = htole64(total * BENCH_SECTOR);
+	unode->fe = fe;
+	unode->ump = ump;
+	if ((error = udf_build_extent_map(unode)) != 0)
+		errx(1, "udf_build_extent_map: %s", strerror(error));
+
+	/* map every block in file order, one call per block */
+	t0 = now();
+	for (blk = 0; blk < total; blk++) {
+		error = udf_bmap_translate(unode, blk, &exttype, &lsector,
+		    &maxblks);
+		if (error != 0)
+			errx(1, "udf_bmap_translate: %s", strerror(error));
+	}
+	t_map = now() - t0;
+
+	t0 = now();
+	for (blk = 0; blk < total; blk++) {
+		error = ref_bmap_translate(unode, blk, &ref_lsector,
+		    &ref_maxblks);
+		if (error != 0)
+			errx(1, "ref_bmap_translate: %s", strerror(error));
+	}
+	t_ref = now() - t0;
+
+	/* both have to agree */
+	for (blk = 0; blk < total; blk += 1 + blk / 64) {
+		udf_bmap_translate(unode, blk, &exttype, &lsector, &maxblks);
+		ref_bmap_translate(unode, blk, &ref_lsector, &ref_maxblks);
+		if (lsector != ref_lsector || maxblks != ref_maxblks)
+			errx(1, "block %u: mapped to %ju+%u instead of %ju+%u",
+			    blk, (uintmax_t)lsector, maxblks,
+			    (uintmax_t)ref_lsector, ref_maxblks);
+	}
+
+	printf("%d extents, %ju blocks mapped one at a time\n", count,
+	    (uintmax_t)total);
+	printf("  extent map %10.3f ms %8.1f ns/block\n", t_map * 1e3,
+	    t_map * 1e9 / total);
+	printf("  rescan     %10.3f ms %8.1f ns/block\n", t_ref * 1e3,
+	    t_ref * 1e9 / total);
+	printf("  speedup    %10.1fx\n", t_ref / t_map);
+
+	udf_user_free(unode->extents, M_UDFTEMP);
+	free(unode->adslots);
+	free(unode);
+	free(fe);
+	free_fake_mount(ump);
+
+	return (0);
+}
+
+/*
+ * Reference for udf_read_node() as it was: one buffer cache read per
+ * logical sector, whatever the run udf_bmap_translate() returned.
+ */
+static int
+ref_read_node(struct udf_node *unode, uint8_t *blob, uint64_t length)
+{
+	struct udf_mount *ump = unode->ump;
+	struct buf *bp;
+	uint64_t lsect;
+	int error, exttype;
+	uint32_t fileblk, numb, numlsect, sector_size;
+
+	sector_size = ump->sector_size;
+	for (fileblk = 0; length > 0; fileblk++) {
+		error = udf_bmap_translate(unode, fileblk, &exttype, &lsect,
+		    &numlsect);
+		if (error != 0)
+			return (error);
+		if (exttype == UDF_TRAN_INTERN)
+			return (udf_read_node(unode, blob, 0, length));
+		numb = MIN(length, sector_size);
+		if (exttype == UDF_TRAN_ZERO)
+			memset(blob, 0, numb);
+		else {
+			error = bread(ump->devvp,
+			    lsect * (sector_size / DEV_BSIZE), sector_size,
+			    NOCRED, &bp);
+			if (error != 0) {
+				brelse(bp);
+				return (error);
+			}
+			memcpy(blob, bp->b_data, numb);
+			brelse(bp);
+		}
+		blob += numb;
+		length -= numb;
+	}
+
+	return (0);
+}
+
+static void
+report_io(const char *what, double t, uint64_t size)
+{
+
+	printf("  %-12s %8ju reads %12ju bytes %10.3f ms %8.1f MB/s\n", what,
+	    (uintmax_t)udf_user_iostat.reads, (uintmax_t)udf_user_iostat.bytes,
+	    t * 1e3, size / t / 1e6);
+}
+
+/*
+ * Count the requests it takes to mount an image and to read whole files
+ * from it, and time them, with clustered reads and one sector at a time.
+ */
+static int
+bench_read(int argc, char **argv)
+{
+	struct udf_mount *ump;
+	struct udf_node *unode;
+	struct vnode *vp;
+	uint64_t size;
+	uint8_t *buf, *ref;
+	double t0;
+	int error, i, status;
+
+	if (argc < 2)
+		usage();
+
+	memset(&udf_user_iostat, 0, sizeof(udf_user_iostat));
+	t0 = now();
+	error = udf_user_mount(argv[0], BENCH_SECTOR, &ump);
+	if (error != 0)
+		errx(1, "%s: cannot mount: %s", argv[0], strerror(error));
+	printf("mount %s\n", argv[0]);
+	report_io("all", now() - t0, udf_user_iostat.bytes);
+
+	status = 0;
+	for (i = 1; i < argc; i++) {
+		error = udf_user_namei(ump, argv[i], &vp);
+		if (error != 0) {
+			warnx("%s: %s", argv[i], strerror(error));
+			status = 1;
+			continue;
+		}
+		unode = vp->v_data;
+		if (unode->fe != NULL)
+			size = le64toh(unode->fe->inf_len);
+		else
+			size = le64toh(unode->efe->inf_len);
+		if (vp->v_type != VREG || size == 0 || size > INT_MAX) {
+			warnx("%s: not a regular file of 1 to %d bytes",
+			    argv[i], INT_MAX);
+			vput(vp);
+			status = 1;
+			continue;
+		}
+		buf = malloc(size);
+		ref = malloc(size);
+		if (buf == NULL || ref == NULL)
+			err(1, "malloc");
+
+		printf("read %s, %ju bytes\n", argv[i], (uintmax_t)size);
+
+		memset(&udf_user_iostat, 0, sizeof(udf_user_iostat));
+		t0 = now();
+		error = udf_read_node(unode, buf, 0, size);
+		if (error != 0)
+			errx(1, "udf_read_node: %s", strerror(error));
+		report_io("clustered", now() - t0, size);
+
+		memset(&udf_user_iostat, 0, sizeof(udf_user_iostat));
+		t0 = now();
+		error = ref_read_node(unode, ref, size);
+		if (error != 0)
+			errx(1, "ref_read_node: %s", strerror(error));
+		report_io("per sector", now() - t0, size);
+
+		if (memcmp(buf, ref, size) != 0)
+			errx(1, "%s: contents differ", argv[i]);
+
+		free(buf);
+		free(ref);
+		vput(vp);
+	}
+
+	udf_user_unmount(ump);
+
+	return (status);
+}
+
+/*
+ * Reference for the sparable case of udf_translate_vtop() as it was: a
+ * scan of the little endian sparing table for every translation.
+ */
+static int
+ref_translate_sparable(struct udf_mount *ump, uint32_t lb_num,
+    uint32_t *lb_numres, uint32_t *extres)
+{
+	struct udf_sparing_table *spt = ump->sparing_table;
+	struct spare_map_entry *sme;
+	uint32_t cnt, lb_packet, lb_rel;
+
+	lb_packet = lb_num / ump->sparable_packet_size;
+	lb_rel = lb_num % ump->sparable_packet_size;
+
+	for (cnt = 0; cnt < le16toh(spt->rt_l); cnt++) {
+		sme = &spt->entries[cnt];
+		if (le32toh(sme->org) == lb_packet) {
+			*lb_numres = le32toh(sme->map) + lb_rel;
+			*extres = ump->sparable_packet_size - lb_rel;
+			return (0);
+		}
+	}
+
+	if (lb_num > le32toh(ump->partitions[0]->part_len))
+		return (EINVAL);
+	*lb_numres = lb_num + le32toh(ump->partitions[0]->start_loc);
+	*extres = ump->sparable_packet_size - lb_rel;
+	return (0);
+}
+
+/*
+ * Translate random blocks of a sparable partition with 0 to 4096 remapped
+ * packets, through the sorted sparing map and by scanning the sparing
+ * table.
+ */
+static int
+bench_sparing(int argc, char **argv)
+{
+	static const int sizes[] = { 0, 16, 64, 256, 1024, 4096 };
+	struct udf_mount *ump;
+	struct udf_sparing_table *spt;
+	struct long_ad icb;
+	double t0, t_map, t_ref;
+	uint32_t *lbs, *packets, extres, lb_numres, ref_extres, ref_numres;
+	uint32_t i, j, k, npackets, part_len, sink, tmp;
+	int hits, lookups, n, error;
+
+	lookups = argc > 0 ? atoi(argv[0]) : 1000000;
+	if (lookups <= 0)
+		usage();
+
+	ump = fake_mount();
+	ump->vtop_tp[0] = UDF_VTOP_TYPE_SPARABLE;
+	ump->sparable_packet_size = 32;
+	part_len = 1024 * 1024;
+	ump->partitions[0]->part_len = htole32(part_len);
+	npackets = part_len / ump->sparable_packet_size;
+
+	packets = malloc(npackets * sizeof(uint32_t));
+	lbs = malloc(lookups * sizeof(uint32_t));
+	if (packets == NULL || lbs == NULL)
+		err(1, "malloc");
+
+	srandom(1);
+	for (i = 0; i < (uint32_t)lookups; i++)
+		lbs[i] = random() % part_len;
+	icb.loc.part_num = htole16(0);
+
+	printf("%d translations, random blocks of a %u block partition\n",
+	    lookups, part_len);
+	printf("%8s %6s %14s %14s %8s\n", "entries", "hits", "map ns/lookup",
+	    "scan ns/lookup", "speedup");
+	sink = 0;
+	for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+		n = sizes[k];
+
+		/* remap n different packets, in random order */
+		for (i = 0; i < npackets; i++)
+			packets[i] = i;
+		for (i = 0; i < (uint32_t)n; i++) {
+			j = i + random() % (npackets - i);
+			tmp = packets[i];
+			packets[i] = packets[j];
+			packets[j] = tmp;
+		}
+		spt = calloc(1, sizeof(struct udf_sparing_table) +
+		    n * sizeof(struct spare_map_entry));
+		if (spt == NULL)
+			err(1, "calloc");
+		spt->rt_l = htole16(n);
+		for (i = 0; i < (uint32_t)n; i++) {
+			spt->entries[i].org = htole32(packets[i]);
+			spt->entries[i].map = htole32(part_len +
+			    i * ump->sparable_packet_size);
+		}
+		ump->sparing_table = spt;
+		udf_build_sparing_map(ump);
+
+		t0 = now();
+		for (i = 0; i < (uint32_t)lookups; i++) {
+			icb.loc.lb_num = htole32(lbs[i]);
+			error = udf_translate_vtop(ump, &icb, &lb_numres,
+			    &extres);
+			if (error != 0)
+				errx(1, "udf_translate_vtop: %s",
+				    strerror(error));
+			sink += lb_numres;
+		}
+		t_map = now() - t0;
+
+		t0 = now();
+		for (i = 0; i < (uint32_t)lookups; i++) {
+			ref_translate_sparable(ump, lbs[i], &ref_numres,
+			    &ref_extres);
+			sink += ref_numres;
+		}
+		t_ref = now() - t0;
+
+		/* both have to agree */
+		hits = 0;
+		for (i = 0; i < (uint32_t)lookups; i++) {
+			icb.loc.lb_num = htole32(lbs[i]);
+			udf_translate_vtop(ump, &icb, &lb_numres, &extres);
+			ref_translate_sparable(ump, lbs[i], &ref_numres,
+			    &ref_extres);
+			if (lb_numres != ref_numres || extres != ref_extres)
+				errx(1, "block %u: mapped to %u+%u instead of "
+				    "%u+%u", lbs[i], lb_numres, extres,
+				    ref_numres, ref_extres);
+			if (lb_numres >= part_len)
+				hits++;
+		}
+
+		printf("%8d %6d %14.1f %14.1f %7.1fx\n", n, hits,
+		    t_map * 1e9 / lookups, t_ref * 1e9 / lookups,
+		    t_ref / t_map);
+
+		udf_user_free(ump->sparing_map, M_UDFTEMP);
+		free(spt);
+	}
+	if (sink == 0)
+		printf("\n");
+
+	free(lbs);
+	free(packets);
+	free_fake_mount(ump);
+
+	return (0);
+}
+
+/* the CRC-ITU table of the specification, built at run time */
+static uint16_t ref_crc_table[256];
+
+static void
+ref_crc_init(void)
+{
+	uint32_t b, bit, crc;
+
+	for (b = 0; b < 256; b++) {
+		crc = b << 8;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		ref_crc_table[b] = crc;
+	}
+}
+
+/* reference for udf_cksum() as it was: one table lookup per byte */
+static uint16_t
+ref_cksum(const uint8_t *s, int n)
+{
+	uint16_t crc = 0;
+
+	while (n-- > 0)
+		crc = ref_crc_table[(crc >> 8 ^ *s++) & 0xff] ^ (crc << 8);
+
+	return (crc);
+}
+
+/*
+ * Throughput of udf_cksum() against the byte-wise table, for buffers from
+ * a descriptor tag payload up to a 64K extent.
+ */
+static int
+bench_cksum(int argc, char **argv)
+{
+	static const int sizes[] = { 16, 64, 512, 2048, 4096, 65536 };
+	static uint8_t vector[] = { 0x70, 0x6A, 0x77 };
+	uint8_t *buf;
+	double t0, t_new, t_ref;
+	uint64_t total;
+	uint32_t i, iters, k, sink;
+	int n, off;
+
+	total = (argc > 0 ? atoi(argv[0]) : 256) * 1024ULL * 1024;
+	if (total == 0)
+		usage();
+
+	ref_crc_init();
+	if (udf_cksum(vector, sizeof(vector)) != 0x3299 ||
+	    ref_cksum(vector, sizeof(vector)) != 0x3299)
+		errx(1, "checksum of the specification vector is not 3299");
+
+	buf = malloc(65536 + 8);
+	if (buf == NULL)
+		err(1, "malloc");
+	srandom(1);
+	for (i = 0; i < 65536 + 8; i++)
+		buf[i] = random();
+
+	/* every alignment, and every length around the 8 byte slices */
+	for (off = 0; off < 8; off++)
+		for (n = 0; n <= 80; n++)
+			if (udf_cksum(buf + off, n) != ref_cksum(buf + off, n))
+				errx(1, "checksum differs at offset %d length "
+				    "%d", off, n);
+
+	printf("%ju MB checksummed per size\n", (uintmax_t)(total >> 20));
+	printf("%8s %12s %12s %8s\n", "size", "udf_cksum", "byte table",
+	    "speedup");
+	sink = 0;
+	for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+		n = sizes[k];
+		iters = total / n;
+
+		if (udf_cksum(buf, n) != ref_cksum(buf, n))
+			errx(1, "checksum differs at length %d", n);
+
+		t0 = now();
+		for (i = 0; i < iters; i++)
+			sink += udf_cksum(buf + (i & 7), n);
+		t_new = now() - t0;
+
+		t0 = now();
+		for (i = 0; i < iters; i++)
+			sink += ref_cksum(buf + (i & 7), n);
+		t_ref = now() - t0;
+
+		printf("%8d %7.2f GB/s %7.2f GB/s %7.1fx\n", n,
+		    (double)iters * n / t_new / 1e9,
+		    (double)iters * n / t_ref / 1e9, t_ref / t_new);
+	}
+	if (sink == 0)
+		printf("\n");
+
+	free(buf);
+
+	return (0);
+}
+
+/* reference for udf_check_tag() as it was: the header summed bytewise */
+static int
+ref_check_tag(void *blob)
+{
+	uint8_t *pos, sum;
+	int cnt;
+
+	pos = blob;
+	sum = 0;
+	for (cnt = 0; cnt < 16; cnt++)
+		if (cnt != 4)
+			sum += pos[cnt];
+	if (sum != pos[4])
+		return (EINVAL);
+
+	return (0);
+}
+
+/* reference for udf_is_blank() as it was: a byte loop */
+static int
+ref_is_blank(void *sector, int sector_size)
+{
+	uint8_t *pos;
+	int cnt;
+
+	pos = sector;
+	for (cnt = 0; cnt < sector_size; cnt++)
+		if (pos[cnt] != 0)
+			return (0);
+
+	return (1);
+}
+
+/*
+ * Time the tag sum and the blank sector test as the descriptor reader runs
+ * them, over every sector of an image.
+ */
+static int
+bench_tags(int argc, char **argv)
+{
+	struct stat st;
+	uint8_t *corpus, *sector;
+	double t0, t_blank, t_ref_blank, t_ref_tag, t_tag;
+	uint64_t nsect, s;
+	int blanks, fd, pass, passes, sink, tags;
+
+	if (argc < 1)
+		usage();
+	passes = argc > 1 ? atoi(argv[1]) : 20;
+	if (passes <= 0)
+		usage();
+
+	if ((fd = open(argv[0], O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+		err(1, "%s", argv[0]);
+	nsect = st.st_size / BENCH_SECTOR;
+	if (nsect == 0)
+		errx(1, "%s: no sectors", argv[0]);
+	corpus = malloc(nsect * BENCH_SECTOR);
+	if (corpus == NULL)
+		err(1, "malloc");
+	if (pread(fd, corpus, nsect * BENCH_SECTOR, 0) !=
+	    (ssize_t)(nsect * BENCH_SECTOR))
+		err(1, "%s", argv[0]);
+	close(fd);
+
+	/* both have to agree */
+	tags = blanks = 0;
+	for (s = 0; s < nsect; s++) {
+		sector = corpus + s * BENCH_SECTOR;
+		if ((udf_check_tag(sector) == 0) != (ref_check_tag(sector) == 0))
+			errx(1, "sector %ju: tag checks differ", (uintmax_t)s);
+		if (udf_is_blank(sector, BENCH_SECTOR) !=
+		    ref_is_blank(sector, BENCH_SECTOR))
+			errx(1, "sector %ju: blank tests differ", (uintmax_t)s);
+		if (udf_is_blank(sector, BENCH_SECTOR))
+			blanks++;
+		else if (udf_check_tag(sector) == 0)
+			tags++;
+	}
+
+	sink = 0;
+	t0 = now();
+	for (pass = 0; pass < passes; pass++)
+		for (s = 0; s < nsect; s++)
+			sink += udf_check_tag(corpus + s * BENCH_SECTOR);
+	t_tag = now() - t0;
+
+	t0 = now();
+	for (pass = 0; pass < passes; pass++)
+		for (s = 0; s < nsect; s++)
+			sink += ref_check_tag(corpus + s * BENCH_SECTOR);
+	t_ref_tag = now() - t0;
+
+	t0 = now();
+	for (pass = 0; pass < passes; pass++)
+		for (s = 0; s < nsect; s++)
+			sink += udf_is_blank(corpus + s * BENCH_SECTOR,
+			    BENCH_SECTOR);
+	t_blank = now() - t0;
+
+	t0 = now();
+	for (pass = 0; pass < passes; pass++)
+		for (s = 0; s < nsect; s++)
+			sink += ref_is_blank(corpus + s * BENCH_SECTOR,
+			    BENCH_SECTOR);
+	t_ref_blank = now() - t0;
+
+	printf("%ju sectors: %d tagged, %d blank, %ju other; %d passes\n",
+	    (uintmax_t)nsect, tags, blanks, (uintmax_t)(nsect - tags - blanks),
+	    passes);
+	printf("%12s %12s %12s %8s\n", "", "ns/sector", "reference",
+	    "speedup");
+	printf("%12s %12.2f %12.2f %7.1fx\n", "tag sum",
+	    t_tag * 1e9 / passes / nsect, t_ref_tag * 1e9 / passes / nsect,
+	    t_ref_tag / t_tag);
+	printf("%12s %12.2f %12.2f %7.1fx\n", "blank test",
+	    t_blank * 1e9 / passes / nsect,
+	    t_ref_blank * 1e9 / passes / nsect, t_ref_blank / t_blank);
+	if (sink == 0)
+		printf("\n");
+
+	free(corpus);
+
+	return (0);
+}
+
+/*
+ * Time mounts on a device with a fixed latency per request, once taking
+ * the requests in flight together at once and once one after the other,
+ * as for a mount that reads its descriptors one by one.
+ */
+static int
+bench_mount(int argc, char **argv)
+{
+	static const char *modes[] = { "concurrent", "serialized" };
+	struct udf_mount *ump;
+	double t0, t;
+	int error, i, mounts, serialize;
+
+	if (argc < 1)
+		usage();
+	udf_user_latency = argc > 1 ? atoi(argv[1]) : 1000;
+	mounts = argc > 2 ? atoi(argv[2]) : 10;
+	if (mounts <= 0)
+		usage();
+
+	printf("%d mounts of %s, %u us per request\n", mounts, argv[0],
+	    udf_user_latency);
+	for (serialize = 0; serialize < 2; serialize++) {
+		udf_user_serialize = serialize;
+		memset(&udf_user_iostat, 0, sizeof(udf_user_iostat));
+		t0 = now();
+		for (i = 0; i < mounts; i++) {
+			error = udf_user_mount(argv[0], BENCH_SECTOR, &ump);
+			if (error != 0)
+				errx(1, "%s: cannot mount: %s", argv[0],
+				    strerror(error));
+			udf_user_unmount(ump);
+		}
+		t = now() - t0;
+		printf("  %-12s %8.2f ms/mount %6ju reads/mount\n",
+		    modes[serialize], t * 1e3 / mounts,
+		    (uintmax_t)(udf_user_iostat.reads / mounts));
+	}
+
+	return (0);
+}
+
+int
+main(int argc, char **argv)
+{
+
+	if (argc < 2)
+		usage();
+
+	if (strcmp(argv[1], "extents") == 0)
+		return (bench_extents(argc - 2, argv + 2));
+	if (strcmp(argv[1], "read") == 0)
+		return (bench_read(argc - 2, argv + 2));
+	if (strcmp(argv[1], "sparing") == 0)
+		return (bench_sparing(argc - 2, argv + 2));
+	if (strcmp(argv[1], "cksum") == 0)
+		return (bench_cksum(argc - 2, argv + 2));
+	if (strcmp(argv[1], "tags") == 0)
+		return (bench_tags(argc - 2, argv + 2));
+	if (strcmp(argv[1], "mount") == 0)
+		return (bench_mount(argc - 2, argv + 2));
+
+	usage();
+}
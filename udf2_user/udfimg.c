@@ -0,0 +1,190 @@
+/*-
+ * Copyright (c) 2026 The udf2 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * udfimg: list and read files of a UDF image using the udf2 core code.
+ *
+ *	udfimg [-b sector_size] image ls [path ...]
+ *	udfimg [-b sector_size] image cat path ...
+ */
+
+#include <err.h>
+#include <unistd.h>
+
+#include "udf_user.h"
+#include "ecma167-udf.h"
+#include "udf.h"
+#include "udf_subr.h"
+
+#define UDFIMG_BUFSIZE	(1024 * 1024)
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "usage: udfimg [-b sector_size] image ls [path ...]\n"
+	    "       udfimg [-b sector_size] image cat path ...\n");
+	exit(1);
+}
+
+static uint64_t
+node_size(struct udf_node *unode)
+{
+
+	if (unode->fe != NULL)
+		return (le64toh(unode->fe->inf_len));
+	return (le64toh(unode->efe->inf_len));
+}
+
+static int
+do_ls(struct udf_mount *ump, const char *path)
+{
+	struct udf_dirstream ds;
+	struct fileid_desc *fid;
+	struct vnode *vp;
+	int error;
+	char unix_name[MAXNAMLEN + 1];
+
+	error = udf_user_namei(ump, path, &vp);
+	if (error != 0) {
+		warnx("%s: %s", path, strerror(error));
+		return (error);
+	}
+
+	if (vp->v_type != VDIR) {
+		printf("%12ju %s\n", (uintmax_t)node_size(vp->v_data), path);
+		vput(vp);
+		return (0);
+	}
+
+	udf_dirstream_init(&ds, vp, 0);
+	for (;;) {
+		error = udf_dirstream_next(&ds, &fid);
+		if (error != 0 || fid == NULL)
+			break;
+		if (fid->file_char & (UDF_FILE_CHAR_DEL | UDF_FILE_CHAR_VIS |
+		    UDF_FILE_CHAR_PAR))
+			continue;
+		udf_to_unix_name(ump, unix_name, MAXNAMLEN,
+		    fid->data + le16toh(fid->l_iu), fid->l_fi);
+		printf("%s%s\n", unix_name,
+		    (fid->file_char & UDF_FILE_CHAR_DIR) ? "/" : "");
+	}
+	udf_dirstream_done(&ds);
+	vput(vp);
+
+	if (error != 0)
+		warnx("%s: %s", path, strerror(error));
+	return (error);
+}
+
+static int
+do_cat(struct udf_mount *ump, const char *path, uint8_t *buf)
+{
+	struct vnode *vp;
+	uint64_t file_size, offset;
+	int error, len;
+
+	error = udf_user_namei(ump, path, &vp);
+	if (error != 0) {
+		warnx("%s: %s", path, strerror(error));
+		return (error);
+	}
+	if (vp->v_type == VDIR) {
+		vput(vp);
+		warnx("%s: %s", path, strerror(EISDIR));
+		return (EISDIR);
+	}
+
+	file_size = node_size(vp->v_data);
+	for (offset = 0; offset < file_size; offset += len) {
+		len = MIN(file_size - offset, UDFIMG_BUFSIZE);
+		error = vn_rdwr(UIO_READ, vp, buf, len, offset, UIO_SYSSPACE,
+		    IO_NODELOCKED, FSCRED, NULL, NULL, curthread);
+		if (error != 0) {
+			warnx("%s: %s", path, strerror(error));
+			break;
+		}
+		if (fwrite(buf, 1, len, stdout) != (size_t)len)
+			err(1, "stdout");
+	}
+	vput(vp);
+
+	return (error);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct udf_mount *ump;
+	uint8_t *buf;
+	u_int sector_size;
+	int ch, error, i, status;
+	char *ep;
+
+	sector_size = 2048;
+	while ((ch = getopt(argc, argv, "b:")) != -1) {
+		switch (ch) {
+		case 'b':
+			sector_size = strtoul(optarg, &ep, 0);
+			if (*ep != '\0')
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 2)
+		usage();
+
+	error = udf_user_mount(argv[0], sector_size, &ump);
+	if (error != 0)
+		errx(1, "%s: cannot mount: %s", argv[0], strerror(error));
+
+	status = 0;
+	if (strcmp(argv[1], "ls") == 0) {
+		if (argc == 2)
+			status |= do_ls(ump, "/");
+		for (i = 2; i < argc; i++)
+			status |= do_ls(ump, argv[i]);
+	} else if (strcmp(argv[1], "cat") == 0) {
+		if (argc == 2)
+			usage();
+		buf = malloc(UDFIMG_BUFSIZE);
+		if (buf == NULL)
+			err(1, "malloc");
+		for (i = 2; i < argc; i++)
+			status |= do_cat(ump, argv[i], buf);
+		free(buf);
+	} else
+		usage();
+
+	udf_user_unmount(ump);
+
+	return (status != 0);
+}
@@ -0,0 +1,232 @@
+/*-
+ * Copyright (c) 2026 The udf2 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * udftest: regression tests of the udf2 core code on synthetic nodes that
+ * need no image.  Run by "make check"; exits non-zero if a test fails.
+ */
+
+#include <err.h>
+
+#include "udf_user.h"
+#include "ecma167-udf.h"
+#include "udf.h"
+#include "udf_subr.h"
+
+#define TEST_SECTOR	2048
+#define TEST_BUFSIZE	65536
+#define TEST_FILL	0xa5
+
+static struct udf_mount *
+fake_mount(void)
+{
+	static struct mount mp;
+	struct udf_mount *ump;
+	struct part_desc *pdesc;
+
+	mp.mnt_iosize_max = MAXPHYS;
+
+	ump = calloc(1, sizeof(struct udf_mount));
+	ump->logical_vol = calloc(1, sizeof(struct logvol_desc));
+	pdesc = calloc(1, sizeof(struct part_desc));
+	if (ump == NULL || ump->logical_vol == NULL || pdesc == NULL)
+		err(1, "calloc");
+
+	ump->vfs_mountp = &mp;
+	ump->sector_size = TEST_SECTOR;
+	ump->logical_vol->lb_size = htole32(TEST_SECTOR);
+	pdesc->part_len = htole32(UINT32_MAX - 1);
+	ump->partitions[0] = pdesc;
+	ump->vtop[0] = 0;
+	ump->vtop_tp[0] = UDF_VTOP_TYPE_PHYS;
+
+	return (ump);
+}
+
+static void
+free_fake_mount(struct udf_mount *ump)
+{
+
+	free(ump->partitions[0]);
+	free(ump->logical_vol);
+	free(ump);
+}
+
+/*
+ * A sparse file of a little over 5GB: five holes of the largest extent
+ * length and two small ones, so that it needs no device.
+ */
+static struct udf_node *
+sparse_node(struct udf_mount *ump, uint64_t *fsize)
+{
+	struct udf_node *unode;
+	struct file_entry *fe;
+	uint32_t len;
+	int error, i;
+
+	unode = calloc(1, sizeof(struct udf_node));
+	fe = calloc(1, sizeof(struct file_entry));
+	unode->adslots = calloc(7, sizeof(struct long_ad));
+	if (unode == NULL || fe == NULL || unode->adslots == NULL)
+		err(1, "calloc");
+
+	*fsize = 0;
+	for (i = 0; i < 7; i++) {
+		len = i < 5 ? rounddown(UDF_EXT_MAXLEN, TEST_SECTOR) :
+		    TEST_BUFSIZE;
+		unode->adslots[i].len = htole32(UDF_EXT_FREE | len);
+		*fsize += len;
+	}
+	unode->num_adslots = 7;
+	fe->icbtag.flags = htole16(UDF_ICB_LONG_ALLOC);
+	fe->inf_len = htole64(*fsize);
+	unode->fe = fe;
+	unode->ump = ump;
+	if ((error = udf_build_extent_map(unode)) != 0)
+		errx(1, "udf_build_extent_map: %s", strerror(error));
+
+	return (unode);
+}
+
+static void
+free_node(struct udf_node *unode)
+{
+
+	udf_user_free(unode->extents, M_UDFTEMP);
+	free(unode->adslots);
+	free(unode->fe);
+	free(unode);
+}
+
+/* buf holds `filled' bytes of the read and the fill pattern after that */
+static int
+check_buf(const char *test, uint8_t *buf, int filled)
+{
+	int i;
+
+	for (i = 0; i < TEST_BUFSIZE; i++) {
+		if (buf[i] != (i < filled ? 0 : TEST_FILL)) {
+			printf("FAIL %s: byte %d is %#x\n", test, i, buf[i]);
+			return (1);
+		}
+	}
+	printf("ok   %s\n", test);
+	return (0);
+}
+
+typedef int (*read_fn)(struct udf_node *, uint8_t *, off_t, int);
+
+/*
+ * Read a buffer at offsets more than 4GB before the end of a file, where
+ * the remaining size does not fit 32 bits, and at its very end.
+ */
+static int
+test_read_4g(const char *name, read_fn readfn)
+{
+	struct udf_mount *ump;
+	struct udf_node *unode;
+	uint64_t fsize;
+	uint8_t *buf;
+	char test[64];
+	int error, fails;
+
+	ump = fake_mount();
+	unode = sparse_node(ump, &fsize);
+	buf = malloc(TEST_BUFSIZE);
+	if (buf == NULL)
+		err(1, "malloc");
+
+	fails = 0;
+
+	snprintf(test, sizeof(test), "%s beyond 4GB from the end", name);
+	memset(buf, TEST_FILL, TEST_BUFSIZE);
+	error = readfn(unode, buf, fsize - (1ULL << 32) - 4096,
+	    TEST_BUFSIZE);
+	if (error != 0) {
+		printf("FAIL %s: %s\n", test, strerror(error));
+		fails++;
+	} else
+		fails += check_buf(test, buf, TEST_BUFSIZE);
+
+	snprintf(test, sizeof(test), "%s across the end", name);
+	memset(buf, TEST_FILL, TEST_BUFSIZE);
+	error = readfn(unode, buf, fsize - 4096, TEST_BUFSIZE);
+	if (error != 0) {
+		printf("FAIL %s: %s\n", test, strerror(error));
+		fails++;
+	} else
+		fails += check_buf(test, buf, 4096);
+
+	free(buf);
+	free_node(unode);
+	free_fake_mount(ump);
+
+	return (fails);
+}
+
+struct async_res {
+	int	done;
+	int	error;
+};
+
+static void
+async_done(void *arg, int error)
+{
+	struct async_res *res = arg;
+
+	res->done = 1;
+	res->error = error;
+}
+
+/* the shim completes requests at once, so the read is done on return */
+static int
+read_node_async(struct udf_node *unode, uint8_t *blob, off_t start,
+    int length)
+{
+	struct async_res res;
+
+	res.done = 0;
+	res.error = 0;
+	udf_read_node_async(unode, blob, start, length, async_done, &res);
+	if (!res.done)
+		return (EINPROGRESS);
+	return (res.error);
+}
+
+int
+main(void)
+{
+	int fails;
+
+	fails = 0;
+	fails += test_read_4g("udf_read_node", udf_read_node);
+	fails += test_read_4g("udf_read_node_direct", udf_read_node_direct);
+	fails += test_read_4g("udf_read_node_async", read_node_async);
+
+	if (fails != 0)
+		printf("%d failed\n", fails);
+	return (fails != 0);
+}